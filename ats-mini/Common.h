@@ -102,6 +102,13 @@ typedef struct
   const char *name;       // Frequency name
 } NamedFreq;
 
+typedef struct
+{
+  uint16_t freq_start;    // Starting frequency
+  uint16_t freq_end;      // Ending frequency (exclusive)
+  const char *name;       // Band name
+} BandLabel;
+
 typedef struct
 {
   int8_t offset;          // UTC offset in 15 minute intervals
@@ -176,10 +183,99 @@ uint8_t doAbout(int dir);
 float batteryMonitor();
 bool drawBattery(int x, int y);
 
+// Radio.cpp
+typedef struct
+{
+  uint32_t time;   // millis() when sampled
+  uint16_t freq;   // Frequency sampled at
+  uint8_t  rssi;   // dBuV
+  uint8_t  snr;    // dB
+  int8_t   offset; // Frequency offset (kHz)
+  bool     stereo; // FM stereo pilot present
+  bool     valid;  // Valid channel, as seek would tell
+} RadioSample;
+
+typedef struct
+{
+  uint32_t tunes;      // Number of completed tunings
+  uint32_t dropped;    // Targets replaced by newer ones
+  uint32_t latency;    // Last time from target to tuning done (ms)
+  uint32_t maxLatency; // Maximum of the above (ms)
+} RadioStats;
+
+bool radioInit();
+void radioLock();
+void radioUnlock();
+void radioSync();
+void radioTune(uint16_t freq);
+void radioSetBFO(int16_t bfo);
+void radioSetAgc(uint8_t disable, uint8_t idx);
+uint16_t radioSetSampleTime(uint16_t period);
+RadioSample radioMeasure();
+bool radioGetSample(RadioSample *sample, uint8_t age = 0);
+bool radioGetStereo();
+const RadioStats *radioGetStats();
+
+// Encoder.cpp
+void encoderPushFromISR(int8_t dir);
+bool encoderPending();
+int encoderRead(int *steps = 0);
+
+// Timer.cpp
+typedef bool (*TimerFunc)();
+
+typedef struct
+{
+  uint32_t wakeups;   // Number of main loop passes
+  uint32_t idleTime;  // Total time spent sleeping (ms)
+} TimerStats;
+
+int timerAdd(uint32_t period, TimerFunc func);
+void timerRestart(int id);
+bool timerTickTime();
+void timerSleep(uint32_t maxTime);
+void timerWake();
+void timerWakeFromISR();
+const TimerStats *timerGetStats();
+
 // Scan.c
-void scanRun(uint16_t centerFreq, uint16_t step);
-float scanGetRSSI(uint16_t freq);
-float scanGetSNR(uint16_t freq);
+typedef struct
+{
+  uint16_t points;    // Number of measured points
+  uint16_t timeouts;  // Points measured without tune completion
+  uint32_t sweepTime; // Total sweep time (ms)
+  uint32_t dwellTime; // Total time spent waiting to measure (ms)
+  uint32_t maxDwell;  // Longest wait for a single point (ms)
+} ScanStats;
+
+typedef struct
+{
+  int      line;      // Next line, 0 = header
+  uint8_t  band;      // Band being exported
+  uint16_t start;     // Data layout when the export started
+  uint16_t step;
+  uint16_t points;
+  uint32_t now;       // millis() when the export started
+  char     text[48];  // Current line
+  uint8_t  pos;       // Bytes of current line already read
+  uint8_t  len;       // Length of current line
+} ScanExport;
+
+bool scanStart(uint16_t step, bool twoPass = false);
+bool scanMap(uint16_t step);
+void scanStop();
+bool scanIsRunning();
+bool scanTickTime(bool refresh = false);
+const ScanStats *scanGetStats();
+uint8_t scanGetHistory();
+float scanGetRSSI(uint16_t freq, uint8_t age = 0);
+float scanGetSNR(uint16_t freq, uint8_t age = 0);
+float scanGetMaxRSSI(uint16_t freq);
+int scanGetStations();
+uint16_t scanStepStation(uint16_t freq, int8_t dir);
+bool scanPrint(Print &out);
+bool scanExportStart(ScanExport *state);
+size_t scanExportRead(ScanExport *state, uint8_t *buf, size_t size);
 
 // Station.c
 const char *getStationName();
@@ -190,6 +286,8 @@ uint16_t getRdsPiCode();
 void clearStationInfo();
 bool checkRds();
 bool identifyFrequency(uint16_t freq, bool periodic = false);
+void clearFrequencyCache();
+const char *getBandLabel(uint16_t freq);
 
 // Network.cpp
 int8_t getWiFiStatus();
@@ -4,6 +4,7 @@
 #include "Utils.h"
 #include "Menu.h"
 #include "Draw.h"
+#include "EIBI.h"
 
 //
 // Draw EEPROM write indicator
@@ -253,12 +254,13 @@ void drawFrequency(uint32_t freq, int x, int y, int ux, int uy, uint8_t hl)
   }
 }
 
+#define WATERFALL_ROWS 12 // Scan sweeps shown above the tuner scale
+
 //
 // Draw tuner scale
 //
 void drawScale(uint32_t freq)
 {
-  spr.fillTriangle(156, 120, 160, 130, 164, 120, TH.scale_pointer);
   spr.drawLine(160, 130, 160, 169, TH.scale_pointer);
 
   spr.setTextDatum(MC_DATUM);
@@ -275,6 +277,10 @@ void drawScale(uint32_t freq)
   uint32_t minFreq = band->minimumFreq / 10;
   uint32_t maxFreq = band->maximumFreq / 10;
 
+  // Show sweep history once there is more than one sweep
+  int history = scanGetHistory();
+  history = history<2? 0 : history<WATERFALL_ROWS? history : WATERFALL_ROWS;
+
   for(int i=0 ; i<41 ; i++, freq++)
   {
     int16_t x = i * 8 - offset;
@@ -307,8 +313,24 @@ void drawScale(uint32_t freq)
       int rssi = 20 * scanGetRSSI(freq * 10);
       if(rssi > 0)
         spr.fillRect(x-1, 170-rssi, 3, rssi, rssi>15? TH.smeter_bar_plus:TH.smeter_bar);
+
+      // Mark highest level seen in previous scans
+      int hold = 20 * scanGetMaxRSSI(freq * 10);
+      if(hold > rssi)
+        spr.drawLine(x-1, 170-hold, x+1, 170-hold, hold>15? TH.smeter_bar_plus:TH.smeter_bar);
+
+      // Draw waterfall of recent sweeps above the scale, latest first
+      for(int age=0 ; age<history ; age++)
+      {
+        float level = scanGetRSSI(freq * 10, age);
+        if(level > 0.0)
+          spr.drawLine(x-4, 120+age, x+3, 120+age, spr.alphaBlend(255 * level, TH.smeter_bar_plus, TH.bg));
+      }
     }
   }
+
+  // Draw pointer over the waterfall
+  spr.fillTriangle(156, 120, 160, 130, 164, 120, TH.scale_pointer);
 }
 
 //
@@ -393,6 +415,10 @@ void drawScreen(const char *statusLine1, const char *statusLine2)
     return;
   }
 
+  // Show EiBi loading progress if there is no other status
+  if(!statusLine1 && !statusLine2 && (statusLine2 = eibiLoadStatus()))
+    statusLine1 = "Loading EiBi Schedule";
+
   switch(uiLayoutIdx)
   {
     case UI_SMETER:
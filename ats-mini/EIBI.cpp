@@ -7,305 +7,761 @@
 #include <LittleFS.h>
 #include <FS.h>
 
+#include <rom/miniz.h>
+#include <esp_rom_crc.h>
 #include <ctype.h>
 #include <string.h>
 
 #define EIBI_PATH "/schedules.bin"
 #define TEMP_PATH "/schedules.tmp"
+#define TAGS_PATH "/schedules.tag"
 #ifndef EIBI_URL
 #define EIBI_URL  "http://eibispace.de/dx/eibi.txt"
 #endif
 
-const BandLabel bandLabels[] =
-{
-  {  472,   479,  "630m (CW)"     },
-  {  500,   518,  "NAVTEX"        },
-  {  525,  1705,  "MW Broadcast"  },
-  { 1600,  1800,  "Top Band"      },
-  { 2300,  2495,  "120m BC"       },
-  { 3200,  3400,  "90m BC"        },
-  { 3500,  3800,  "80m (Amateur)" },
-  { 3700,  3800,  "80m (SSB)"     },
-  { 3900,  4000,  "75m BC"        },
-  { 4720,  4750,  "60m (Amateur)" },
-  { 4750,  4995,  "60m BC"        },
-  { 5900,  6200,  "49m BC"        },
-  { 7000,  7040,  "40m (CW)"      },
-  { 7040,  7100,  "40m (DIGI)"    },
-  { 7100,  7200,  "40m (SSB)"     },
-  { 7200,  7600,  "41m BC"        },
-  { 9400,  9900,  "31m BC"        },
-  {10100, 10140,  "30m (CW)"      },
-  {10136, 10140,  "30m (FT8)"     },
-  {10140, 10150,  "30m (DIGI)"    },
-  {11600, 12100,  "25m BC"        },
-  {14000, 14070,  "20m (CW)"      },
-  {14070, 14100,  "20m (DIGI/FT8)"},
-  {14100, 14350,  "20m (SSB)"     },
-  {15100, 15800,  "19m BC"        },
-  {18068, 18110,  "17m (CW)"      },
-  {18100, 18110,  "17m (FT8)"     },
-  {18110, 18168,  "17m (SSB)"     },
-  {17480, 17900,  "16m BC"        },
-  {21000, 21070,  "15m (CW)"      },
-  {21070, 21100,  "15m (DIGI/FT8)"},
-  {21100, 21450,  "15m (SSB)"     },
-  {21450, 21850,  "13m BC"        },
-  {24890, 24915,  "12m (CW)"      },
-  {24915, 24925,  "12m (FT8)"     },
-  {24925, 24990,  "12m (SSB)"     },
-  {26960, 27410,  "11m (CB)"      },
-  {25670, 26100,  "11m BC"        },
-  {28000, 28120,  "10m (CW)"      },
-  {28120, 28190,  "10m (DIGI/FT8)"},
-  {28200, 29700,  "10m (SSB/FM)"  },
-  {26100, 26500,  "11m BC"        },
-  {29600, 30000,  "9m BC"         }
+// Schedule file format
+#define EIBI_MAGIC   "EIBI"
+#define EIBI_VERSION 4
+
+// Number of schedule entries per sparse index slot
+#define EIBI_INDEX_STRIDE 32
+
+// Schedule file is read and cached in blocks of this size
+#define EIBI_BLOCK_SIZE   4096
+#define EIBI_CACHE_BLOCKS 8
+
+// Schedule time is tracked in 15 minute slots
+#define EIBI_SLOT_TIME    15
+#define EIBI_SLOTS        (24 * 60 / EIBI_SLOT_TIME)
+
+// Schedule is downloaded in chunks of this size
+#define EIBI_CHUNK_SIZE   4096
+
+// Schedule is sorted in memory runs of this many entries, spilled to
+// temporary files and merged this many files at a time
+#define EIBI_RUN_SIZE     1024
+#define EIBI_MERGE_WAYS   6
+#define EIBI_RUN_PATH     "/schedules.%03d"
+
+// Schedule is loaded by a background task with this stack size, the
+// final loading status is shown for this many milliseconds
+#define EIBI_TASK_STACK   8192
+#define EIBI_STATUS_TIME  3000
+
+// Station name table limits (name IDs are 16bit)
+#define EIBI_MAX_NAMES    8192
+#define EIBI_NAME_HASH    16384
+
+// Name search limit: best matching entries kept for sorting
+#define EIBI_SEARCH_ENTRIES 256
+
+// Number of lookups, and of seeks per time slot, timed by eibiBenchmark()
+#define EIBI_BENCH_LOOKUPS  1000
+#define EIBI_BENCH_SEEKS    32
+
+//
+// Schedule file starts with this header, followed by entries,
+// followed by the name table. The name table consists of name
+// offsets (uint32_t each), followed by zero-terminated names.
+// The name table is followed by the word index and postings.
+//
+// The word index lists every word in every name as a uint32_t
+// (name ID << 8 | word position in name), sorted by the rest of
+// the name starting with that word, ignoring case. Postings are
+// (names + 1) uint32_t offsets into the following list of entry
+// indices (uint32_t each), grouping entries by name.
+//
+typedef struct __attribute__((packed))
+{
+  char     magic[4];      // EIBI_MAGIC
+  uint16_t version;       // EIBI_VERSION
+  uint16_t names;         // Number of station names
+  uint32_t entries;       // Number of schedule entries
+  uint32_t nameOffset;    // File offset of the name table
+  uint32_t nameSize;      // Size of the name table in bytes
+  uint32_t words;         // Number of words in the word index
+  uint32_t wordOffset;    // File offset of the word index
+  uint32_t postOffset;    // File offset of the postings
+} EibiHeader;
+
+typedef struct __attribute__((packed))
+{
+  uint16_t freq;          // Frequency in kHz
+  uint16_t name;          // Station name ID
+  int8_t   start_h;       // Starting hour (0..23, -1 = any)
+  int8_t   start_m;       // Starting minute
+  int8_t   end_h;         // Ending hour
+  int8_t   end_m;         // Ending minute
+  uint8_t  slots[EIBI_SLOTS / 8]; // Bitmap of active time slots
+} EibiEntry;
+
+// Schedule reader state, keeps schedule file open between lookups
+static struct
+{
+  fs::File file;          // Open schedule file
+  int8_t   state;         // -1: unknown, 0: no schedule, 1: schedule open
+  size_t   total;         // Total number of entries in the file
+  uint16_t names;         // Total number of station names
+  uint32_t *nameTable;    // Name offsets followed by names
+  uint32_t words;         // Number of words in the word index
+  uint32_t wordOffset;    // File offset of the word index
+  uint32_t postOffset;    // File offset of the postings
+  uint32_t clock;         // LRU clock, incremented on each block access
+  struct
+  {
+    uint8_t *data;        // Block data (EIBI_BLOCK_SIZE bytes)
+    size_t   block;       // Block number in the file
+    size_t   size;        // Valid bytes in the block (0 = empty)
+    uint32_t used;        // Last access time, for LRU
+  } cache[EIBI_CACHE_BLOCKS];
+} eibi = { fs::File(), -1 };
+
+// Schedule is also searched from the web server task, so public
+// functions hold this lock while accessing the reader state
+static SemaphoreHandle_t eibiMutex = xSemaphoreCreateRecursiveMutex();
+
+class EibiLock
+{
+  public:
+    EibiLock()  { xSemaphoreTakeRecursive(eibiMutex, portMAX_DELAY); }
+    ~EibiLock() { xSemaphoreGiveRecursive(eibiMutex); }
 };
 
-// FIXME: this might be slow
-bool eibiAvailable()
+// Timing of the last successful import, written by the loader task
+static struct
+{
+  uint32_t bytes;         // Bytes received
+  uint32_t time;          // Total time, including sorting (ms)
+  uint32_t parseTime;     // Time spent decompressing and parsing (ms)
+} eibiImport;
+
+// Sparse frequency index, one frequency per EIBI_INDEX_STRIDE entries
+static uint16_t *eibiIndex = NULL;
+static size_t eibiIndexSize = 0;
+
+// Entries active in a given time slot, sorted by frequency
+static struct
+{
+  int       slot;         // Time slot of the view (-1 = not built)
+  size_t    count;        // Number of active entries
+  uint16_t *freqs;        // Active entry frequencies
+  uint32_t *entries;      // Active entry indices
+} eibiOnAir = { -1 };
+
+static void *eibiAlloc(size_t size)
 {
-  return(LittleFS.exists(EIBI_PATH));
+  return(psramFound()? ps_malloc(size) : malloc(size));
 }
 
-static bool entryIsNow(const StationSchedule *entry, int now)
+//
+// Drop the sparse index, it will be rebuilt on next lookup
+//
+static void eibiFreeIndex()
 {
-  // Check if entry applies to all hours
-  if(entry->start_h < 0 || entry->end_h < 0) return(true);
+  if(eibiIndex) free(eibiIndex);
+  eibiIndex = NULL;
+  eibiIndexSize = 0;
+}
 
-  // These are starting/ending times in minutes
-  int start = entry->start_h * 60 + entry->start_m;
-  int end   = entry->end_h * 60 + entry->end_m;
+//
+// Drop the on-air view, it will be rebuilt on next seek
+//
+static void eibiFreeOnAir()
+{
+  if(eibiOnAir.freqs) free(eibiOnAir.freqs);
+  if(eibiOnAir.entries) free(eibiOnAir.entries);
+  eibiOnAir.freqs   = NULL;
+  eibiOnAir.entries = NULL;
+  eibiOnAir.count   = 0;
+  eibiOnAir.slot    = -1;
+}
 
-  // Check for inclusive schedule
-  if(start <= end && now >= start && now <= end) return(true);
+//
+// Close schedule file and drop all cached data
+//
+static void eibiClose()
+{
+  if(eibi.file) eibi.file.close();
 
-  // Check for exclusive schedule
-  if(start > end && (now >= start || now <= end)) return(true);
+  for(int j=0 ; j<EIBI_CACHE_BLOCKS ; ++j)
+    eibi.cache[j].size = 0;
 
-  // Nope
-  return(false);
+  if(eibi.nameTable) free(eibi.nameTable);
+  eibi.nameTable = NULL;
+
+  eibiFreeIndex();
+  eibiFreeOnAir();
+  eibi.total = 0;
+  eibi.names = 0;
+  eibi.words = 0;
+  eibi.state = -1;
 }
 
-const StationSchedule *eibiNext(uint16_t freq, uint8_t hour, uint8_t minute, size_t *offset)
+//
+// Open schedule file, unless it is already open or known to be missing
+//
+static bool eibiOpen()
 {
-  // Will return this static entry
-  static StationSchedule entry;
+  EibiHeader hdr;
 
-  // Must have valid offset
-  if(!offset) return(NULL);
+  if(eibi.state>=0) return(eibi.state>0);
 
-  // If no valid offset yet, find some
-  if(*offset==(size_t)-1) eibiLookup(freq, hour, minute, offset);
+  eibi.state = 0;
+  eibi.total = 0;
+  eibi.names = 0;
+  eibi.words = 0;
 
-  // Open file with EIBI data
-  fs::File file = LittleFS.open(EIBI_PATH, "rb");
-  if(!file) return(NULL);
+  // Allocate cache blocks once
+  for(int j=0 ; j<EIBI_CACHE_BLOCKS ; ++j)
+  {
+    if(!eibi.cache[j].data)
+      eibi.cache[j].data = (uint8_t *)eibiAlloc(EIBI_BLOCK_SIZE);
+    if(!eibi.cache[j].data) return(false);
+    eibi.cache[j].size = 0;
+  }
 
-  StationSchedule *result = NULL;
-  int now = hour * 60 + minute;
+  // The file may be missing, do not use open() to avoid error messages
+  if(!LittleFS.exists(EIBI_PATH)) return(false);
+
+  eibi.file = LittleFS.open(EIBI_PATH, "rb");
+  if(!eibi.file) return(false);
+
+  // Check file header, older schedule files have to be reloaded
+  if((eibi.file.read((uint8_t*)&hdr, sizeof(hdr)) != sizeof(hdr))
+  || memcmp(hdr.magic, EIBI_MAGIC, sizeof(hdr.magic))
+  || (hdr.version != EIBI_VERSION)
+  || (hdr.names > EIBI_MAX_NAMES)
+  || (hdr.nameSize < hdr.names * sizeof(uint32_t))
+  || (hdr.nameOffset + hdr.nameSize > eibi.file.size())
+  || (sizeof(hdr) + hdr.entries * sizeof(EibiEntry) > hdr.nameOffset)
+  || (hdr.wordOffset + hdr.words * sizeof(uint32_t) > hdr.postOffset)
+  || (hdr.postOffset + (hdr.names + 1 + hdr.entries) * sizeof(uint32_t) > eibi.file.size()))
+  {
+    eibi.file.close();
+    return(false);
+  }
 
-  // Go to the starting offset
-  if(!file.seek(*offset, fs::SeekSet))
+  // Load station names into memory
+  eibi.nameTable = (uint32_t *)eibiAlloc(hdr.nameSize + 1);
+  if(!eibi.nameTable
+  || !eibi.file.seek(hdr.nameOffset, fs::SeekSet)
+  || (eibi.file.read((uint8_t*)eibi.nameTable, hdr.nameSize) != hdr.nameSize))
   {
-    file.close();
-    return(NULL);
+    eibiClose();
+    eibi.state = 0;
+    return(false);
   }
 
-  while(file.read((uint8_t*)&entry, sizeof(entry)) == sizeof(entry))
+  // Make sure the last name is terminated
+  ((char *)eibi.nameTable)[hdr.nameSize] = '\0';
+
+  eibi.total      = hdr.entries;
+  eibi.names      = hdr.names;
+  eibi.words      = hdr.words;
+  eibi.wordOffset = hdr.wordOffset;
+  eibi.postOffset = hdr.postOffset;
+  eibi.state      = 1;
+  return(true);
+}
+
+//
+// Read data from the schedule file via the block cache
+//
+static bool eibiRead(size_t pos, void *buf, size_t size)
+{
+  uint8_t *dst = (uint8_t *)buf;
+
+  if(!eibiOpen()) return(false);
+
+  while(size)
   {
-    if((entry.freq>freq) && entryIsNow(&entry, now))
+    size_t block = pos / EIBI_BLOCK_SIZE;
+    int j, lru;
+
+    // Look for the block in cache, remembering least recently used one
+    for(j=lru=0 ; j<EIBI_CACHE_BLOCKS ; ++j)
     {
-      *offset = file.position() - sizeof(entry);
-      result = &entry;
-      break;
+      if(eibi.cache[j].size && eibi.cache[j].block==block) break;
+      if(eibi.cache[j].used < eibi.cache[lru].used) lru = j;
     }
+
+    // Not cached, read block into the least recently used slot
+    if(j>=EIBI_CACHE_BLOCKS)
+    {
+      j = lru;
+      eibi.cache[j].size = 0;
+      if(!eibi.file.seek(block * EIBI_BLOCK_SIZE, fs::SeekSet)) return(false);
+      eibi.cache[j].size  = eibi.file.read(eibi.cache[j].data, EIBI_BLOCK_SIZE);
+      eibi.cache[j].block = block;
+    }
+
+    eibi.cache[j].used = ++eibi.clock;
+
+    // Copy data from the block
+    size_t offset = pos - block * EIBI_BLOCK_SIZE;
+    if(offset >= eibi.cache[j].size) return(false);
+    size_t n = eibi.cache[j].size - offset;
+    n = n > size? size : n;
+    memcpy(dst, eibi.cache[j].data + offset, n);
+
+    dst  += n;
+    pos  += n;
+    size -= n;
   }
 
-  file.close();
-  return(result);
+  return(true);
 }
 
-const StationSchedule *eibiPrev(uint16_t freq, uint8_t hour, uint8_t minute, size_t *offset)
+static inline bool eibiReadEntry(size_t idx, EibiEntry *entry)
+{
+  return(idx<eibi.total && eibiRead(sizeof(EibiHeader) + idx * sizeof(*entry), entry, sizeof(*entry)));
+}
+
+static const char *eibiName(uint16_t id)
+{
+  if(id>=eibi.names) return("");
+  return((const char *)(eibi.nameTable + eibi.names) + eibi.nameTable[id]);
+}
+
+//
+// Convert schedule file entry into a StationSchedule
+//
+static void eibiFillSchedule(StationSchedule *result, const EibiEntry *entry)
+{
+  result->freq    = entry->freq;
+  result->start_h = entry->start_h;
+  result->start_m = entry->start_m;
+  result->end_h   = entry->end_h;
+  result->end_m   = entry->end_m;
+  strncpy(result->name, eibiName(entry->name), sizeof(result->name) - 1);
+  result->name[sizeof(result->name)-1] = '\0';
+}
+
+static const StationSchedule *eibiSchedule(const EibiEntry *entry)
 {
   // Will return this static entry
-  static StationSchedule entry;
+  static StationSchedule result;
 
-  // Must have valid offset
-  if(!offset) return(NULL);
+  eibiFillSchedule(&result, entry);
+  return(&result);
+}
+
+bool eibiAvailable()
+{
+  EibiLock lock;
+  return(eibiOpen());
+}
 
-  // If no valid offset yet, find some
-  if(*offset==(size_t)-1) eibiLookup(freq, hour, minute, offset);
+//
+// Build sparse index of the schedule file, keeping it in PSRAM
+// if available. The file is read sequentially, one stride at a time.
+//
+static bool eibiBuildIndex()
+{
+  EibiEntry entry;
 
-  // Open file with EIBI data
-  fs::File file = LittleFS.open(EIBI_PATH, "rb");
-  if(!file) return(NULL);
+  eibiFreeIndex();
+  if(!eibiOpen()) return(false);
 
-  StationSchedule *result = NULL;
-  int now = hour * 60 + minute;
+  size_t slots = (eibi.total + EIBI_INDEX_STRIDE - 1) / EIBI_INDEX_STRIDE;
+  if(!slots) return(false);
 
-  for(size_t pos = *offset; file.seek(pos, fs::SeekSet) ; pos -= sizeof(entry))
-  {
-    if(file.read((uint8_t*)&entry, sizeof(entry)) != sizeof(entry)) break;
+  eibiIndex = (uint16_t *)eibiAlloc(slots * sizeof(uint16_t));
+  if(!eibiIndex) return(false);
 
-    if((entry.freq<freq) && entryIsNow(&entry, now))
+  for(size_t j=0 ; j<slots ; ++j)
+  {
+    if(!eibiReadEntry(j * EIBI_INDEX_STRIDE, &entry))
     {
-      *offset = pos;
-      result = &entry;
-      break;
+      eibiFreeIndex();
+      return(false);
     }
+
+    eibiIndex[j] = entry.freq;
   }
 
-  file.close();
-  return(result);
+  eibiIndexSize = slots;
+  return(true);
 }
 
-const StationSchedule *eibiAtSameFreq(uint8_t hour, uint8_t minute, size_t *offset, bool same)
+static inline int eibiSlot(uint8_t hour, uint8_t minute)
 {
-  // Will return this static entry
-  static StationSchedule entry;
+  return((hour * 60 + minute) / EIBI_SLOT_TIME % EIBI_SLOTS);
+}
 
-  // Must have valid offset
-  if(!offset) return(NULL);
+static inline bool entryIsNow(const EibiEntry *entry, int slot)
+{
+  return(entry->slots[slot >> 3] & (1 << (slot & 7)));
+}
+
+//
+// Make sure on-air view matches given time slot, rebuilding it with
+// a single sequential pass over the schedule when the slot changes
+//
+static bool eibiUpdateOnAir(int slot)
+{
+  EibiEntry entry;
 
-  // Open file with EIBI data
-  fs::File file = LittleFS.open(EIBI_PATH, "rb");
-  if(!file) return(NULL);
+  if(eibiOnAir.slot==slot) return(true);
+  if(!eibiOpen()) return(false);
 
-  // Read current entry to get frequency
-  StationSchedule e0;
-  if(!file.seek(*offset, fs::SeekSet) || file.read((uint8_t*)&e0, sizeof(e0)) != sizeof(e0))
+  // Allocate view large enough for all entries
+  if(!eibiOnAir.freqs)
   {
-    file.close();
-    return(NULL);
+    eibiOnAir.freqs   = (uint16_t *)eibiAlloc(eibi.total * sizeof(uint16_t) + 1);
+    eibiOnAir.entries = (uint32_t *)eibiAlloc(eibi.total * sizeof(uint32_t) + 1);
+    if(!eibiOnAir.freqs || !eibiOnAir.entries)
+    {
+      eibiFreeOnAir();
+      return(false);
+    }
+  }
+
+  // Collect active entries, they are already sorted by frequency
+  eibiOnAir.count = 0;
+  for(size_t idx=0 ; eibiReadEntry(idx, &entry) ; ++idx)
+  {
+    if(entryIsNow(&entry, slot))
+    {
+      eibiOnAir.freqs[eibiOnAir.count]   = entry.freq;
+      eibiOnAir.entries[eibiOnAir.count] = idx;
+      eibiOnAir.count++;
+    }
+  }
+
+  eibiOnAir.slot = slot;
+  return(true);
+}
+
+const StationSchedule *eibiNext(uint16_t freq, uint8_t hour, uint8_t minute, size_t *offset)
+{
+  EibiLock lock;
+  EibiEntry entry;
+
+  // Must have valid offset and on-air view
+  if(!offset || !eibiUpdateOnAir(eibiSlot(hour, minute))) return(NULL);
+
+  // Find the first active entry above given frequency
+  size_t left = 0, right = eibiOnAir.count;
+  while(left < right)
+  {
+    size_t mid = (left + right) / 2;
+    if(eibiOnAir.freqs[mid] > freq) right = mid; else left = mid + 1;
   }
 
-  StationSchedule *result = NULL;
-  int now = hour * 60 + minute;
+  if(left>=eibiOnAir.count || !eibiReadEntry(eibiOnAir.entries[left], &entry))
+    return(NULL);
+
+  *offset = eibiOnAir.entries[left];
+  return(eibiSchedule(&entry));
+}
+
+const StationSchedule *eibiPrev(uint16_t freq, uint8_t hour, uint8_t minute, size_t *offset)
+{
+  EibiLock lock;
+  EibiEntry entry;
+
+  // Must have valid offset and on-air view
+  if(!offset || !eibiUpdateOnAir(eibiSlot(hour, minute))) return(NULL);
 
-  if(same && entryIsNow(&e0, now))
+  // Find the last active entry below given frequency
+  size_t left = 0, right = eibiOnAir.count;
+  while(left < right)
   {
-    entry = e0;
-    result = &entry;
-    file.close();
-    return(result);
+    size_t mid = (left + right) / 2;
+    if(eibiOnAir.freqs[mid] < freq) left = mid + 1; else right = mid;
   }
 
-  while(file.read((uint8_t*)&entry, sizeof(entry)) == sizeof(entry))
+  if(!left || !eibiReadEntry(eibiOnAir.entries[left-1], &entry))
+    return(NULL);
+
+  *offset = eibiOnAir.entries[left-1];
+  return(eibiSchedule(&entry));
+}
+
+const StationSchedule *eibiAtSameFreq(uint8_t hour, uint8_t minute, size_t *offset, bool same)
+{
+  EibiLock lock;
+  EibiEntry entry, e0;
+
+  // Must have valid offset
+  if(!offset) return(NULL);
+
+  // Read current entry to get frequency
+  size_t idx = *offset;
+  if(!eibiReadEntry(idx, &e0)) return(NULL);
+
+  int now = eibiSlot(hour, minute);
+
+  if(same && entryIsNow(&e0, now)) return(eibiSchedule(&e0));
+
+  while(eibiReadEntry(++idx, &entry))
   {
     if(entry.freq != e0.freq)
       break;
     else if(entryIsNow(&entry, now))
     {
-      *offset = file.position() - sizeof(entry);
-      result = &entry;
-      break;
+      *offset = idx;
+      return(eibiSchedule(&entry));
     }
   }
 
-  file.close();
-  return(result);
+  return(NULL);
 }
 
 const StationSchedule *eibiLookup(uint16_t freq, uint8_t hour, uint8_t minute, size_t *offset)
 {
-  // Will return this static entry
-  static StationSchedule entry;
+  EibiLock lock;
+  EibiEntry entry;
 
-  // Open file with EIBI data
-  fs::File file = LittleFS.open(EIBI_PATH, "rb");
-  if(!file) return(NULL);
+  // Build sparse index if not built yet
+  if(!eibiIndex && !eibiBuildIndex()) return(NULL);
 
-  // Set up binary search
-  ssize_t total = file.size() / sizeof(entry);
+  // Find the last index slot below given frequency, the first
+  // matching entry will be within the next EIBI_INDEX_STRIDE entries
   ssize_t left  = 0;
-  ssize_t right = total;
-  ssize_t match = -1;
-  ssize_t mid;
+  ssize_t right = eibiIndexSize - 1;
+  ssize_t slot  = 0;
 
-  // Search for the frequency
   while(left <= right)
   {
-    // Go to the middle entry
-    mid = (left + right) / 2;
-
-    // Save current offset, correcting for file size
-    if(offset) *offset = (mid<0? 0 : mid>=total? total-1 : mid) * sizeof(entry);
-
-    // Go to the middle entry
-    if(!file.seek(mid * sizeof(entry), fs::SeekSet))
+    ssize_t mid = (left + right) / 2;
+    if(eibiIndex[mid] < freq)
     {
-      file.close();
-      return(NULL);
-    }
-
-    // Read middle entry
-    if(file.read((uint8_t*)&entry, sizeof(entry)) != sizeof(entry))
-    {
-      file.close();
-      return(NULL);
-    }
-
-    // Compare frequency
-    if(entry.freq < freq)
+      slot = mid;
       left = mid + 1;
-    else if(entry.freq > freq)
-      right = mid - 1;
+    }
     else
-    {
-      match = mid;
       right = mid - 1;
-    }
   }
 
-  // Drop out if not found
-  if(match < 0)
+  // Skip entries below given frequency
+  size_t idx;
+  for(idx = slot * EIBI_INDEX_STRIDE ; eibiReadEntry(idx, &entry) && entry.freq<freq ; ++idx);
+
+  // Save current offset, correcting for file size
+  if(offset) *offset = idx<eibi.total? idx : eibi.total - 1;
+
+  // This is our current time slot
+  int now = eibiSlot(hour, minute);
+
+  // Keep checking entries with matching frequency
+  for( ; idx<eibi.total ; ++idx)
   {
-    file.close();
-    return(NULL);
+    if(!eibiReadEntry(idx, &entry)) break;
+
+    // Report entry offset
+    if(offset) *offset = idx;
+
+    // Match frequency
+    if(entry.freq != freq) break;
+
+    // Match time
+    if(entryIsNow(&entry, now)) return(eibiSchedule(&entry));
   }
 
-  // If found entry is not the same as the last read entry...
-  if(match != mid)
+  // Not found
+  return(NULL);
+}
+
+//
+// Time schedule access against the installed schedule, sweeping
+// frequencies across the whole schedule and hours across the day
+//
+const EibiStats *eibiBenchmark()
+{
+  static EibiStats stats;
+  EibiLock lock;
+
+  memset(&stats, 0, sizeof(stats));
+  stats.importBytes = eibiImport.bytes;
+  stats.importTime  = eibiImport.time;
+  stats.parseTime   = eibiImport.parseTime;
+  if(!eibiIndex && !eibiBuildIndex()) return(&stats);
+
+  uint16_t lo = eibiIndex[0];
+  uint16_t hi = eibiIndex[eibiIndexSize - 1];
+  uint32_t start = micros();
+
+  for(int j=0 ; j<EIBI_BENCH_LOOKUPS ; ++j)
+    eibiLookup(lo + (uint32_t)(hi - lo) * j / EIBI_BENCH_LOOKUPS, j % 24, 0);
+
+  stats.lookups = EIBI_BENCH_LOOKUPS * 1000000ULL / (micros() - start + 1);
+
+  // Seek up from the bottom in every time slot of the day,
+  // timing on-air view rebuilds separately
+  uint32_t seeks = 0, seekTime = 0;
+  for(int slot=0 ; slot<EIBI_SLOTS ; ++slot)
   {
-    // Read the right entry
-    if(file.seek(match * sizeof(entry), fs::SeekSet))
-      if(file.read((uint8_t*)&entry, sizeof(entry)) == sizeof(entry))
-        mid = match;
+    uint8_t hour   = slot * EIBI_SLOT_TIME / 60;
+    uint8_t minute = slot * EIBI_SLOT_TIME % 60;
+    uint16_t freq  = 0;
+    size_t offset;
 
-    // Drop out if failed to read
-    if(match != mid)
+    start = millis();
+    if(!eibiUpdateOnAir(slot)) break;
+    uint32_t time = millis() - start;
+    if(time > stats.rebuildTime) stats.rebuildTime = time;
+
+    for(int j=0 ; j<EIBI_BENCH_SEEKS ; ++j, ++seeks)
     {
-      file.close();
-      return(NULL);
+      start = micros();
+      const StationSchedule *schedule = eibiNext(freq, hour, minute, &offset);
+      time = micros() - start;
+
+      seekTime += time;
+      if(time > stats.maxSeek) stats.maxSeek = time;
+      if(!schedule) break;
+      freq = schedule->freq;
     }
   }
 
-  // This is our current time in minutes
-  int now = hour * 60 + minute;
+  stats.seekTime = seeks? seekTime / seeks : 0;
+  return(&stats);
+}
+
+//
+// Compare query with the name text starting at the given word,
+// ignoring case, up to the query length
+//
+static int eibiCompareWord(uint32_t word, const char *query, size_t len)
+{
+  const char *name = eibiName(word >> 8);
+  return(strncasecmp(name + (word & 0xFF), query, len));
+}
+
+static bool eibiReadWord(size_t idx, uint32_t *word)
+{
+  return(idx<eibi.words && eibiRead(eibi.wordOffset + idx * sizeof(*word), word, sizeof(*word)));
+}
+
+// Search result candidate
+typedef struct
+{
+  uint32_t entry;         // Entry index
+  uint16_t freq;          // Entry frequency
+  bool     onAir;         // TRUE: entry is currently on air
+} EibiFound;
+
+//
+// Sort search results, stations on air first, then by frequency
+//
+static int eibiCompareFound(const void *a, const void *b)
+{
+  const EibiFound *f1 = (const EibiFound *)a;
+  const EibiFound *f2 = (const EibiFound *)b;
+
+  if(f1->onAir != f2->onAir) return(f1->onAir? -1 : 1);
+  if(f1->freq != f2->freq) return(f1->freq < f2->freq? -1 : 1);
+  return(f1->entry < f2->entry? -1 : f1->entry > f2->entry? 1 : 0);
+}
+
+//
+// Add search result candidate, keeping the best EIBI_SEARCH_ENTRIES
+// candidates in a heap with the worst one on top, so that it can be
+// replaced by a better one when the heap is full
+//
+static void eibiKeepFound(EibiFound *found, int *count, const EibiFound *item)
+{
+  int j, k;
 
-  // Keep reading entries from file
-  do
+  if(*count < EIBI_SEARCH_ENTRIES)
+  {
+    // Move worse parents down
+    for(j = (*count)++ ; j>0 && eibiCompareFound(&found[k = (j - 1) / 2], item) < 0 ; j = k)
+      found[j] = found[k];
+    found[j] = *item;
+  }
+  else if(eibiCompareFound(item, &found[0]) < 0)
   {
-    // Report offset within the file
-    if(offset) *offset = file.position() - sizeof(entry);
+    // Replace the worst candidate, moving worse children up
+    for(j = 0 ; (k = 2 * j + 1) < *count ; j = k)
+    {
+      if(k + 1 < *count && eibiCompareFound(&found[k], &found[k + 1]) < 0) ++k;
+      if(eibiCompareFound(&found[k], item) <= 0) break;
+      found[j] = found[k];
+    }
+    found[j] = *item;
+  }
+}
 
-    // Match frequency
-    if(entry.freq != freq) break;
+//
+// Find schedules for stations with names containing words starting
+// with the given query. Results are sorted by frequency, with
+// stations currently on air first (hour>23 if time is unknown).
+// Returns number of results, sets onAir to the number of results
+// currently on air.
+//
+int eibiSearch(const char *query, uint8_t hour, uint8_t minute, StationSchedule *results, int maxResults, int *onAir)
+{
+  static uint8_t seen[EIBI_MAX_NAMES / 8];
+  static EibiFound found[EIBI_SEARCH_ENTRIES];
+  EibiLock lock;
+  uint32_t word;
+  int foundCnt, j, k;
+
+  if(onAir) *onAir = 0;
+
+  // Skip white space around the query
+  while(*query==' ') ++query;
+  size_t len = strlen(query);
+  while(len && query[len-1]==' ') --len;
+  if(!len || !eibiOpen() || !eibi.words) return(0);
+
+  // Find the first word starting with the query
+  size_t left  = 0;
+  size_t right = eibi.words;
+  while(left < right)
+  {
+    size_t mid = (left + right) / 2;
+    if(!eibiReadWord(mid, &word)) return(0);
+    if(eibiCompareWord(word, query, len) < 0) left = mid + 1; else right = mid;
+  }
 
-    // Match time
-    if(entryIsNow(&entry, now))
+  // This is our current time slot
+  int now = hour<24? eibiSlot(hour, minute) : -1;
+
+  // Collect entries of all names with matching words, ranking them
+  // as they come, so that stations on air are never cut off
+  memset(seen, 0, sizeof(seen));
+  for(foundCnt = 0 ; eibiReadWord(left, &word) ; ++left)
+  {
+    if(eibiCompareWord(word, query, len)) break;
+    uint16_t id = word >> 8;
+    if(id>=eibi.names || (seen[id >> 3] & (1 << (id & 7)))) continue;
+    seen[id >> 3] |= 1 << (id & 7);
+
+    uint32_t range[2];
+    if(!eibiRead(eibi.postOffset + id * sizeof(uint32_t), range, sizeof(range)))
+      break;
+
+    for(uint32_t n = range[0] ; n<range[1] ; ++n)
     {
-      file.close();
-      return(&entry);
+      size_t pos = eibi.postOffset + (eibi.names + 1 + n) * sizeof(uint32_t);
+      EibiEntry entry;
+      EibiFound item;
+
+      if(!eibiRead(pos, &item.entry, sizeof(item.entry)) || !eibiReadEntry(item.entry, &entry)) break;
+
+      item.freq  = entry.freq;
+      item.onAir = now>=0 && entryIsNow(&entry, now);
+      eibiKeepFound(found, &foundCnt, &item);
     }
   }
-  while(file.read((uint8_t*)&entry, sizeof(entry)) == sizeof(entry));
 
-  // Not found
-  file.close();
-  return(NULL);
+  // Sort entries, stations on air first, then by frequency
+  qsort(found, foundCnt, sizeof(EibiFound), eibiCompareFound);
+
+  // Return results
+  for(j=k=0 ; j<foundCnt && k<maxResults ; ++j)
+  {
+    EibiEntry entry;
+    if(!eibiReadEntry(found[j].entry, &entry)) continue;
+    eibiFillSchedule(&results[k++], &entry);
+    if(onAir && found[j].onAir) (*onAir)++;
+  }
+
+  return(k);
 }
 
 char replace_accented_char(char c)
@@ -333,148 +789,1085 @@ char replace_accented_char(char c)
   }
 }
 
-static bool eibiParseLine(const char *line, StationSchedule &entry)
+//
+// Mark time slots when the entry is active, end time is exclusive
+//
+static void eibiSetSlots(EibiEntry &entry)
 {
-  char nameStr[sizeof(entry.name) + 1];
-  char freqStr[15] = {0};
-  char timeStr[10] = {0};
-  char tmpCol[12]  = {0};
-  char *p, *t;
+  memset(entry.slots, 0, sizeof(entry.slots));
 
-  // Scan line for data
-  if(sscanf(line, "%14c%9c%11c%24c", freqStr, timeStr, tmpCol, nameStr)<3)
-    return(false);
+  // Check if entry applies to all hours
+  if(entry.start_h < 0 || entry.end_h < 0)
+  {
+    memset(entry.slots, 0xFF, sizeof(entry.slots));
+    return;
+  }
+
+  // These are starting/ending times in minutes
+  int start = entry.start_h * 60 + entry.start_m;
+  int end   = entry.end_h * 60 + entry.end_m;
+
+  // Convert to slots, wrapping around midnight if needed
+  end   = (end + (start > end? 24 * 60 : 0) + EIBI_SLOT_TIME - 1) / EIBI_SLOT_TIME;
+  start = start / EIBI_SLOT_TIME;
+
+  // Mark at least one slot
+  end = end > start? end : start + 1;
+
+  for(int j=start ; j<end ; ++j)
+    entry.slots[(j % EIBI_SLOTS) >> 3] |= 1 << ((j % EIBI_SLOTS) & 7);
+}
+
+//
+// Parse given number of decimal digits, return -1 if not a number
+//
+static int eibiParseDigits(const char *p, int len)
+{
+  int result = 0;
 
-  // Terminate found data
-  freqStr[14] = '\0';
-  timeStr[9] = '\0';
-  nameStr[24] = '\0';
+  for(int j=0 ; j<len ; ++j)
+  {
+    if(p[j]<'0' || p[j]>'9') return(-1);
+    result = result * 10 + p[j] - '0';
+  }
 
-  // Parse frequency
-  entry.freq = (uint16_t)atof(freqStr);
-  if(!entry.freq) return(false);
+  return(result);
+}
 
-  // Parse time
-  int sh, sm, eh, em;
-  if(sscanf(timeStr, "%2d%2d-%2d%2d", &sh, &sm, &eh, &em) != 4) return(false);
+//
+// Parse fixed-column EiBi schedule line:
+// frequency (14 columns), time (9 columns), days and ITU code
+// (11 columns), station name (24 columns), other data
+//
+static bool eibiParseLine(const char *line, int len, EibiEntry &entry, char *name, size_t nameSize)
+{
+  const char *p, *t;
+  int freq, j;
+
+  // Must have frequency, time, and at least some of the next column
+  if(len < 14 + 9 + 1) return(false);
+
+  // Parse frequency, ignoring the fractional part
+  for(p = line ; p < line + 14 && (*p==' ' || *p=='\t') ; ++p);
+  for(freq = 0 ; p < line + 14 && *p>='0' && *p<='9' && freq<=0xFFFF ; ++p)
+    freq = freq * 10 + *p - '0';
+  if(!freq || freq>0xFFFF) return(false);
+  entry.freq = freq;
+
+  // Parse time as HHMM-HHMM
+  const char *time = line + 14;
+  int sh = eibiParseDigits(time, 2);
+  int sm = eibiParseDigits(time + 2, 2);
+  int eh = eibiParseDigits(time + 5, 2);
+  int em = eibiParseDigits(time + 7, 2);
+  if(sh<0 || sm<0 || eh<0 || em<0 || time[4]!='-') return(false);
   entry.start_h = sh;
   entry.start_m = sm;
   entry.end_h   = eh;
   entry.end_m   = em;
 
+  // Precompute active time slots
+  eibiSetSlots(entry);
+
+  // Find station name column
+  p = line + 14 + 9 + 11;
+  t = p + 24;
+  p = p < line + len? p : line + len;
+  t = t < line + len? t : line + len;
+
   // Remove jammers
-  if(strstr(nameStr, "Jammer")) return(false);
+  for(const char *s = p ; s + 6 <= t ; ++s)
+    if(!memcmp(s, "Jammer", 6)) return(false);
 
   // Remove leading and trailing white space from name
-  for(p = nameStr ; *p==' ' || *p=='\t' ; ++p);
-  for(t = p + strlen(p) - 1 ; t>=p && (*t==' ' || *t=='\t') ; *t--='\0');
+  for( ; p<t && (*p==' ' || *p=='\t') ; ++p);
+  for( ; t>p && (t[-1]==' ' || t[-1]=='\t') ; --t);
+
+  // Copy name, replacing accented characters
+  for(j=0 ; p<t && j<nameSize-1 ; ++j, ++p)
+    name[j] = replace_accented_char(*p);
+  name[j] = '\0';
+
+  // Done
+  return(true);
+}
+
+// Station names collected while loading schedule
+static struct
+{
+  char     *data;         // Zero-terminated names
+  uint32_t  size;         // Used bytes in data
+  uint32_t  capacity;     // Allocated bytes in data
+  uint32_t *offsets;      // Name offsets in data
+  uint16_t *hash;         // Hash table of name IDs + 1 (0 = empty)
+  uint16_t  count;        // Number of names
+} eibiNames;
+
+static void eibiFreeNames()
+{
+  if(eibiNames.data) free(eibiNames.data);
+  if(eibiNames.offsets) free(eibiNames.offsets);
+  if(eibiNames.hash) free(eibiNames.hash);
+  memset(&eibiNames, 0, sizeof(eibiNames));
+}
+
+static bool eibiInitNames()
+{
+  eibiFreeNames();
+
+  eibiNames.capacity = 16384;
+  eibiNames.data     = (char *)eibiAlloc(eibiNames.capacity);
+  eibiNames.offsets  = (uint32_t *)eibiAlloc(EIBI_MAX_NAMES * sizeof(uint32_t));
+  eibiNames.hash     = (uint16_t *)eibiAlloc(EIBI_NAME_HASH * sizeof(uint16_t));
 
-  // Replace accented characters
-  for (t = p; *t != '\0'; t++) {
-    *t = replace_accented_char(*t);
+  if(!eibiNames.data || !eibiNames.offsets || !eibiNames.hash)
+  {
+    eibiFreeNames();
+    return(false);
   }
 
-  // Copy name
-  strncpy(entry.name, p, sizeof(entry.name) - 1);
-  entry.name[sizeof(entry.name)-1] = '\0';
+  memset(eibiNames.hash, 0, EIBI_NAME_HASH * sizeof(uint16_t));
+  return(true);
+}
 
-  // Done
+//
+// Return ID of the given station name, adding it if new
+// (returns -1 if out of memory)
+//
+static int eibiAddName(const char *name)
+{
+  uint32_t h = 2166136261U;
+  size_t len = strlen(name);
+
+  // FNV-1a hash of the name
+  for(const char *p = name ; *p ; ++p) h = (h ^ (uint8_t)*p) * 16777619U;
+
+  // Look for existing name, using linear probing
+  for(h &= EIBI_NAME_HASH - 1 ; eibiNames.hash[h] ; h = (h + 1) & (EIBI_NAME_HASH - 1))
+  {
+    uint16_t id = eibiNames.hash[h] - 1;
+    if(!strcmp(eibiNames.data + eibiNames.offsets[id], name)) return(id);
+  }
+
+  // Check name count limit
+  if(eibiNames.count >= EIBI_MAX_NAMES) return(-1);
+
+  // Grow name storage if needed
+  if(eibiNames.size + len + 1 > eibiNames.capacity)
+  {
+    uint32_t capacity = eibiNames.capacity * 2;
+    char *data = (char *)(psramFound()? ps_realloc(eibiNames.data, capacity) : realloc(eibiNames.data, capacity));
+    if(!data) return(-1);
+    eibiNames.data = data;
+    eibiNames.capacity = capacity;
+  }
+
+  // Add new name
+  memcpy(eibiNames.data + eibiNames.size, name, len + 1);
+  eibiNames.offsets[eibiNames.count] = eibiNames.size;
+  eibiNames.size += len + 1;
+  eibiNames.hash[h] = ++eibiNames.count;
+  return(eibiNames.count - 1);
+}
+
+//
+// Compare schedule entries by frequency, time, and name
+// (names are compared as strings while eibiNames is loaded)
+//
+static int eibiCompare(const void *a, const void *b)
+{
+  const EibiEntry *e1 = (const EibiEntry *)a;
+  const EibiEntry *e2 = (const EibiEntry *)b;
+
+  if(e1->freq != e2->freq) return(e1->freq < e2->freq? -1 : 1);
+  if(e1->start_h != e2->start_h) return(e1->start_h - e2->start_h);
+  if(e1->start_m != e2->start_m) return(e1->start_m - e2->start_m);
+  if(e1->end_h != e2->end_h) return(e1->end_h - e2->end_h);
+  if(e1->end_m != e2->end_m) return(e1->end_m - e2->end_m);
+  if(e1->name == e2->name) return(0);
+  return(strcmp(eibiNames.data + eibiNames.offsets[e1->name], eibiNames.data + eibiNames.offsets[e2->name]));
+}
+
+//
+// Sort entries in memory and remove duplicates, return new count
+//
+static int eibiSortRun(EibiEntry *entries, int count)
+{
+  int j, k;
+
+  qsort(entries, count, sizeof(EibiEntry), eibiCompare);
+
+  for(j = k = 0 ; j<count ; ++j)
+    if(!k || eibiCompare(entries + k - 1, entries + j))
+      entries[k++] = entries[j];
+
+  return(k);
+}
+
+static void eibiRunPath(char *path, int run)
+{
+  sprintf(path, EIBI_RUN_PATH, run);
+}
+
+//
+// Sort entries in memory and write them to a temporary run file
+//
+static bool eibiWriteRun(EibiEntry *entries, int count, int run)
+{
+  char path[32];
+
+  eibiRunPath(path, run);
+  fs::File file = LittleFS.open(path, "wb");
+  if(!file) return(false);
+
+  count = eibiSortRun(entries, count);
+  size_t size = count * sizeof(EibiEntry);
+  bool result = file.write((uint8_t*)entries, size) == size;
+
+  file.close();
+  return(result);
+}
+
+//
+// Merge given temporary run files into the output file, removing
+// duplicate entries and using buffer for output. Optionally saves
+// name IDs of written entries. Returns the number of written entries
+// or -1 on failure.
+//
+static int eibiMergeRuns(fs::File &out, int first, int count, EibiEntry *buf, int bufSize, uint16_t *names = NULL)
+{
+  fs::File in[EIBI_MERGE_WAYS];
+  EibiEntry head[EIBI_MERGE_WAYS], prev;
+  bool valid[EIBI_MERGE_WAYS];
+  char path[32];
+  int j, k, written, bufCnt;
+  bool result = true;
+
+  // Open run files and read their first entries
+  for(j=0 ; j<count ; ++j)
+  {
+    eibiRunPath(path, first + j);
+    in[j] = LittleFS.open(path, "rb");
+    valid[j] = in[j] && in[j].read((uint8_t*)&head[j], sizeof(EibiEntry)) == sizeof(EibiEntry);
+    result &= !!in[j];
+  }
+
+  for(written = bufCnt = 0 ; result ; )
+  {
+    // Find the smallest entry among run heads
+    for(j=0, k=-1 ; j<count ; ++j)
+      if(valid[j] && (k<0 || eibiCompare(&head[j], &head[k])<0)) k = j;
+
+    // Done when all runs are exhausted
+    if(k<0) break;
+
+    // Output the entry unless it duplicates the previous one
+    if(!written || eibiCompare(&prev, &head[k]))
+    {
+      if(bufCnt >= bufSize)
+      {
+        size_t size = bufCnt * sizeof(EibiEntry);
+        result &= out.write((uint8_t*)buf, size) == size;
+        bufCnt = 0;
+      }
+
+      prev = buf[bufCnt++] = head[k];
+      if(names) names[written] = head[k].name;
+      written++;
+    }
+
+    // Advance the run the entry came from
+    valid[k] = in[k].read((uint8_t*)&head[k], sizeof(EibiEntry)) == sizeof(EibiEntry);
+  }
+
+  // Write remaining entries
+  if(bufCnt && result)
+  {
+    size_t size = bufCnt * sizeof(EibiEntry);
+    result &= out.write((uint8_t*)buf, size) == size;
+  }
+
+  // Close and remove run files
+  for(j=0 ; j<count ; ++j)
+  {
+    if(in[j]) in[j].close();
+    eibiRunPath(path, first + j);
+    LittleFS.remove(path);
+  }
+
+  return(result? written : -1);
+}
+
+// Background loading states
+#define EIBI_LOAD_IDLE      0
+#define EIBI_LOAD_RUNNING   1 // Loader task is running
+#define EIBI_LOAD_READY     2 // New schedule is in TEMP_PATH
+#define EIBI_LOAD_UNCHANGED 3 // Schedule has not changed
+#define EIBI_LOAD_FAILED    4 // Loading failed
+#define EIBI_LOAD_FINISHED  5 // Showing final status
+
+// Loading progress, written by the loader task and read by the main
+// loop. The task only changes state when it is done, everything else
+// is word-sized and safe to read at any time.
+static volatile struct
+{
+  uint8_t     state;      // EIBI_LOAD_* state
+  const char *message;    // Status message, NULL to show counters
+  uint32_t    bytes;      // Bytes downloaded so far
+  uint32_t    entries;    // Entries parsed so far
+} eibiProgress;
+
+// Server validators, sent with the request and replaced with the
+// response ones by the loader task
+static struct
+{
+  char etag[128];
+  char modified[128];
+} eibiTags;
+
+// Schedule text parser state while loading
+static struct
+{
+  char       line[200];   // Current line
+  int        length;      // Current line length
+  EibiEntry *batch;       // Entries not yet sorted into runs
+  int        batchCnt;    // Number of entries in batch
+  int        runCnt;      // Number of runs written
+  int        lineCnt;     // Number of entries parsed
+  bool       result;      // FALSE: failed writing runs
+} eibiParser;
+
+//
+// Parse schedule text, collecting entries into sorted runs
+//
+static void eibiParseText(const uint8_t *data, size_t len)
+{
+  for(size_t j=0 ; j<len ; ++j)
+  {
+    char c = data[j];
+
+    if(c!='\n' && eibiParser.length<sizeof(eibiParser.line)-1)
+    {
+      // Replace CRs with spaces
+      eibiParser.line[eibiParser.length++] = c=='\r'? ' ' : c;
+      continue;
+    }
+
+    char *p, *t;
+
+    // Remove whitespace
+    eibiParser.line[eibiParser.length] = '\0';
+    for(p = eibiParser.line ; *p && *p<=' ' ; ++p);
+    for(t = eibiParser.line + eibiParser.length ; t>p && t[-1]<=' ' ; --t);
+
+    // If parsed a valid non-empty schedule line...
+    EibiEntry *entry = eibiParser.batch + eibiParser.batchCnt;
+    char name[sizeof(((StationSchedule *)0)->name)];
+    int id;
+    if(t>p && isdigit(*p)
+    && eibiParseLine(p, t - p, *entry, name, sizeof(name))
+    && (id = eibiAddName(name)) >= 0)
+    {
+      entry->name = id;
+      eibiParser.lineCnt++;
+
+      // Sort entries in runs, spilling them to temporary files
+      if(++eibiParser.batchCnt >= EIBI_RUN_SIZE)
+      {
+        eibiParser.result &= eibiWriteRun(eibiParser.batch, eibiParser.batchCnt, eibiParser.runCnt++);
+        eibiParser.batchCnt = 0;
+      }
+    }
+
+    // Done with the current buffer, start a new one
+    eibiParser.length = 0;
+    if(c!='\n') eibiParser.line[eibiParser.length++] = c;
+  }
+}
+
+// Gzip decoder states
+#define EIBI_GZIP_DETECT  0 // Check for gzip magic number
+#define EIBI_GZIP_HEADER  1 // Skipping gzip header
+#define EIBI_GZIP_DATA    2 // Inflating compressed data
+#define EIBI_GZIP_TRAILER 3 // Checking CRC32 and size trailer
+#define EIBI_GZIP_DONE    4 // Compressed data ended
+#define EIBI_GZIP_NONE    5 // Data is not compressed
+
+// Gzip header flags
+#define EIBI_GZIP_FHCRC    0x02
+#define EIBI_GZIP_FEXTRA   0x04
+#define EIBI_GZIP_FNAME    0x08
+#define EIBI_GZIP_FCOMMENT 0x10
+
+// Gzip decoder state while loading, inflating data into a
+// TINFL_LZ_DICT_SIZE circular buffer that also serves as window
+static struct
+{
+  tinfl_decompressor *inflator;
+  uint8_t  *dict;         // Decompressed data window
+  size_t    dictPos;      // Current position in the window
+  uint8_t   state;        // EIBI_GZIP_* state
+  uint8_t   flags;        // Gzip header flags
+  uint32_t  pos;          // Position in the gzip header or trailer
+  uint32_t  skip;         // Header bytes left to skip
+  uint8_t   xlen;         // Low byte of extra field length
+  uint32_t  crc;          // CRC32 of decompressed data
+  uint32_t  size;         // Size of decompressed data
+  uint8_t   trailer[8];   // CRC32 and size, as sent
+} eibiGzip;
+
+static void eibiFreeGzip()
+{
+  if(eibiGzip.inflator) free(eibiGzip.inflator);
+  if(eibiGzip.dict) free(eibiGzip.dict);
+  eibiGzip.inflator = NULL;
+  eibiGzip.dict     = NULL;
+}
+
+static bool eibiInitGzip()
+{
+  eibiFreeGzip();
+
+  eibiGzip.inflator = (tinfl_decompressor *)eibiAlloc(sizeof(tinfl_decompressor));
+  eibiGzip.dict     = (uint8_t *)eibiAlloc(TINFL_LZ_DICT_SIZE);
+  eibiGzip.dictPos  = 0;
+
+  if(!eibiGzip.inflator || !eibiGzip.dict) return(false);
+
+  tinfl_init(eibiGzip.inflator);
   return(true);
 }
 
-bool eibiLoadSchedule()
+//
+// Skip gzip header (RFC 1952), return number of consumed bytes
+//
+static size_t eibiGzipHeader(const uint8_t *data, size_t len)
 {
-  static const char *eibiMessage = "Loading EiBi Schedule";
-  HTTPClient http;
+  size_t j;
 
-  // Need to be connected to the network
-  if(getWiFiStatus() < 2) return(false);
+  for(j=0 ; j<len && eibiGzip.state==EIBI_GZIP_HEADER ; ++j)
+  {
+    uint8_t c = data[j];
+    uint32_t pos = eibiGzip.pos++;
+
+    if(eibiGzip.skip)
+    {
+      // Skipping extra field or header CRC
+      --eibiGzip.skip;
+    }
+    else if(pos<10)
+    {
+      // Fixed header: magic, method, flags, time, extra flags, OS
+      if(pos==3) eibiGzip.flags = c;
+    }
+    else if(eibiGzip.flags & EIBI_GZIP_FEXTRA)
+    {
+      // Extra field length, followed by the extra field
+      if(pos==10) eibiGzip.xlen = c;
+      else
+      {
+        eibiGzip.skip   = eibiGzip.xlen | (c << 8);
+        eibiGzip.flags &= ~EIBI_GZIP_FEXTRA;
+      }
+    }
+    else if(eibiGzip.flags & EIBI_GZIP_FNAME)
+    {
+      // Zero-terminated file name
+      if(!c) eibiGzip.flags &= ~EIBI_GZIP_FNAME;
+    }
+    else if(eibiGzip.flags & EIBI_GZIP_FCOMMENT)
+    {
+      // Zero-terminated comment
+      if(!c) eibiGzip.flags &= ~EIBI_GZIP_FCOMMENT;
+    }
+
+    // Check if the header is complete, skipping header CRC last
+    if(pos>=9 && !eibiGzip.skip
+    && !(eibiGzip.flags & (EIBI_GZIP_FEXTRA|EIBI_GZIP_FNAME|EIBI_GZIP_FCOMMENT)))
+    {
+      if(!(eibiGzip.flags & EIBI_GZIP_FHCRC))
+        eibiGzip.state = EIBI_GZIP_DATA;
+      else
+      {
+        eibiGzip.flags &= ~EIBI_GZIP_FHCRC;
+        eibiGzip.skip   = 2;
+      }
+    }
+  }
+
+  return(j);
+}
+
+//
+// Decompress downloaded data if it is gzipped, passing the result
+// to the text parser. Returns false on a decompression error.
+//
+static bool eibiInflate(const uint8_t *data, size_t len)
+{
+  // Detect gzip magic number at the start of data
+  if(eibiGzip.state==EIBI_GZIP_DETECT && len)
+    eibiGzip.state = data[0]==0x1F? EIBI_GZIP_HEADER : EIBI_GZIP_NONE;
+
+  // Uncompressed data goes straight to the parser
+  if(eibiGzip.state==EIBI_GZIP_NONE)
+  {
+    eibiParseText(data, len);
+    return(true);
+  }
+
+  // Skip gzip header
+  if(eibiGzip.state==EIBI_GZIP_HEADER)
+  {
+    size_t n = eibiGzipHeader(data, len);
+    data += n;
+    len  -= n;
+  }
+
+  while(eibiGzip.state==EIBI_GZIP_DATA)
+  {
+    size_t inBytes  = len;
+    size_t outBytes = TINFL_LZ_DICT_SIZE - eibiGzip.dictPos;
+    uint8_t *out    = eibiGzip.dict + eibiGzip.dictPos;
+
+    tinfl_status status = tinfl_decompress(
+      eibiGzip.inflator, data, &inBytes,
+      eibiGzip.dict, out, &outBytes,
+      TINFL_FLAG_HAS_MORE_INPUT
+    );
+
+    data += inBytes;
+    len  -= inBytes;
+
+    // Parse decompressed text, wrapping around the window
+    eibiParseText(out, outBytes);
+    eibiGzip.dictPos = (eibiGzip.dictPos + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+    eibiGzip.crc     = esp_rom_crc32_le(eibiGzip.crc, out, outBytes);
+    eibiGzip.size   += outBytes;
+
+    if(status < TINFL_STATUS_DONE) return(false);
+    if(status == TINFL_STATUS_DONE)
+    {
+      eibiGzip.state = EIBI_GZIP_TRAILER;
+      eibiGzip.pos   = 0;
+    }
+    else if(status == TINFL_STATUS_NEEDS_MORE_INPUT && !len) break;
+  }
+
+  // Collect gzip trailer and check it against decompressed data
+  for( ; len && eibiGzip.state==EIBI_GZIP_TRAILER ; --len)
+  {
+    eibiGzip.trailer[eibiGzip.pos++] = *data++;
+    if(eibiGzip.pos < sizeof(eibiGzip.trailer)) continue;
+
+    // Both values are little endian
+    const uint8_t *t = eibiGzip.trailer;
+    uint32_t crc  = t[0] | (t[1] << 8) | (t[2] << 16) | ((uint32_t)t[3] << 24);
+    uint32_t size = t[4] | (t[5] << 8) | (t[6] << 16) | ((uint32_t)t[7] << 24);
+    if(crc != eibiGzip.crc || size != eibiGzip.size) return(false);
+    eibiGzip.state = EIBI_GZIP_DONE;
+  }
+
+  // Ignore anything after the trailer
+  return(true);
+}
+
+//
+// Check that compressed data, if any, has ended properly
+//
+static inline bool eibiGzipComplete()
+{
+  return(eibiGzip.state!=EIBI_GZIP_HEADER && eibiGzip.state!=EIBI_GZIP_DATA && eibiGzip.state!=EIBI_GZIP_TRAILER);
+}
+
+static inline const char *eibiWordText(uint32_t word)
+{
+  return(eibiNames.data + eibiNames.offsets[word >> 8] + (word & 0xFF));
+}
+
+static int eibiCompareWords(const void *a, const void *b)
+{
+  uint32_t w1 = *(const uint32_t *)a;
+  uint32_t w2 = *(const uint32_t *)b;
+  int result = strcasecmp(eibiWordText(w1), eibiWordText(w2));
+  return(result? result : w1 < w2? -1 : w1 > w2? 1 : 0);
+}
+
+static inline bool eibiIsWordStart(const char *name, int pos)
+{
+  return(isalnum((uint8_t)name[pos]) && (!pos || !isalnum((uint8_t)name[pos-1])));
+}
+
+//
+// Write word index and postings for the loaded station names and
+// given name IDs of written entries, updating header
+//
+static bool eibiWriteSearchIndex(fs::File &file, const uint16_t *entryNames, uint32_t entries, EibiHeader &hdr)
+{
+  uint32_t words = 0;
+  bool result;
+  int j, k;
 
-  drawScreen(eibiMessage, "Connecting...");
+  // Count words in all names
+  for(j=0 ; j<eibiNames.count ; ++j)
+  {
+    const char *name = eibiNames.data + eibiNames.offsets[j];
+    for(k=0 ; name[k] && k<256 ; ++k) words += eibiIsWordStart(name, k);
+  }
+
+  uint32_t *wordIndex = (uint32_t *)eibiAlloc((words + 1) * sizeof(uint32_t));
+  uint32_t *postings  = (uint32_t *)eibiAlloc((eibiNames.count + 1 + entries) * sizeof(uint32_t));
+  if(!wordIndex || !postings)
+  {
+    if(wordIndex) free(wordIndex);
+    if(postings) free(postings);
+    return(false);
+  }
+
+  // Collect and sort words
+  for(j=0, words=0 ; j<eibiNames.count ; ++j)
+  {
+    const char *name = eibiNames.data + eibiNames.offsets[j];
+    for(k=0 ; name[k] && k<256 ; ++k)
+      if(eibiIsWordStart(name, k)) wordIndex[words++] = (j << 8) | k;
+  }
+
+  qsort(wordIndex, words, sizeof(uint32_t), eibiCompareWords);
+
+  // Group entries by name: count entries per name, convert counts
+  // to offsets, then place entries, advancing offsets
+  uint32_t *first = postings;
+  uint32_t *list  = postings + eibiNames.count + 1;
+  memset(first, 0, (eibiNames.count + 1) * sizeof(uint32_t));
+  for(uint32_t n=0 ; n<entries ; ++n) first[entryNames[n] + 1]++;
+  for(j=0 ; j<eibiNames.count ; ++j) first[j + 1] += first[j];
+  for(uint32_t n=0 ; n<entries ; ++n) list[first[entryNames[n]]++] = n;
+  for(j=eibiNames.count ; j>0 ; --j) first[j] = first[j - 1];
+  first[0] = 0;
+
+  // Write word index and postings
+  size_t wordSize = words * sizeof(uint32_t);
+  size_t postSize = (eibiNames.count + 1 + entries) * sizeof(uint32_t);
+  hdr.words       = words;
+  hdr.wordOffset  = file.position();
+  result          = file.write((uint8_t*)wordIndex, wordSize) == wordSize;
+  hdr.postOffset  = file.position();
+  result         &= file.write((uint8_t*)postings, postSize) == postSize;
+
+  free(wordIndex);
+  free(postings);
+  return(result);
+}
+
+//
+// Read server validators (ETag and Last-Modified) saved together
+// with the current schedule, return false if there are none
+//
+static bool eibiReadTags(char *etag, char *modified, size_t size)
+{
+  char buf[256];
+  char *p;
+
+  *etag = *modified = '\0';
+
+  // Tags are only valid together with the schedule they came with
+  if(!eibiAvailable()) return(false);
+
+  fs::File file = LittleFS.open(TAGS_PATH, "rb");
+  if(!file) return(false);
+  size_t len = file.read((uint8_t*)buf, sizeof(buf) - 1);
+  file.close();
+  buf[len] = '\0';
+
+  // First line is ETag, second line is Last-Modified
+  if(!(p = strchr(buf, '\n'))) return(false);
+  *p++ = '\0';
+  if(char *t = strchr(p, '\n')) *t = '\0';
+
+  strncpy(etag, buf, size - 1);
+  etag[size - 1] = '\0';
+  strncpy(modified, p, size - 1);
+  modified[size - 1] = '\0';
+  return(*etag || *modified);
+}
+
+static void eibiWriteTags(const char *etag, const char *modified)
+{
+  if(!*etag && !*modified) return;
+
+  fs::File file = LittleFS.open(TAGS_PATH, "wb");
+  if(file)
+  {
+    file.write((const uint8_t*)etag, strlen(etag));
+    file.write('\n');
+    file.write((const uint8_t*)modified, strlen(modified));
+    file.write('\n');
+    file.close();
+  }
+}
+
+//
+// Download and convert schedule into TEMP_PATH, return final state
+// (runs in the loader task, must not touch the open schedule)
+//
+static uint8_t eibiDownload()
+{
+  HTTPClient http;
+
+  eibiProgress.message = "Connecting...";
 
   // Open HTTP connection to EiBi site
+  static const char *tagHeaders[] = { "ETag", "Last-Modified", "Content-Encoding" };
+  const char *encodingHeader = tagHeaders[2];
   http.begin(EIBI_URL);
-  if(http.GET() != HTTP_CODE_OK)
+  http.collectHeaders(tagHeaders, ITEM_COUNT(tagHeaders));
+
+  // Ask for compressed data, it is much smaller. Stick to HTTP/1.0,
+  // so that the body is not chunked and the server closes the
+  // connection when done, since the raw stream is read below.
+  http.setAcceptEncoding("gzip");
+  http.useHTTP10(true);
+
+  // Only ask for the schedule if it has changed since last time
+  if(*eibiTags.etag) http.addHeader("If-None-Match", eibiTags.etag);
+  if(*eibiTags.modified) http.addHeader("If-Modified-Since", eibiTags.modified);
+
+  int status = http.GET();
+  if(status == HTTP_CODE_NOT_MODIFIED)
   {
-    drawScreen(eibiMessage, "Failed connecting to EiBi!");
+    eibiProgress.message = "Schedule is up to date";
     http.end();
-    return(false);
+    return(EIBI_LOAD_UNCHANGED);
+  }
+  else if(status != HTTP_CODE_OK)
+  {
+    eibiProgress.message = "Failed connecting to EiBi!";
+    http.end();
+    return(EIBI_LOAD_FAILED);
   }
 
+  // Remember validators for the new schedule
+  strncpy(eibiTags.etag, http.header(tagHeaders[0]).c_str(), sizeof(eibiTags.etag) - 1);
+  eibiTags.etag[sizeof(eibiTags.etag) - 1] = '\0';
+  strncpy(eibiTags.modified, http.header(tagHeaders[1]).c_str(), sizeof(eibiTags.modified) - 1);
+  eibiTags.modified[sizeof(eibiTags.modified) - 1] = '\0';
+
   // Open file in the local flash file system
   fs::File file = LittleFS.open(TEMP_PATH, "wb");
   if(!file)
   {
-    drawScreen(eibiMessage, "Failed opening local storage!");
+    eibiProgress.message = "Failed opening local storage!";
     http.end();
-    return(false);
+    return(EIBI_LOAD_FAILED);
+  }
+
+  // Allocate station name table
+  if(!eibiInitNames())
+  {
+    eibiProgress.message = "Out of memory!";
+    file.close();
+    http.end();
+    return(EIBI_LOAD_FAILED);
+  }
+
+  // Leave space for the header, it will be written last
+  EibiHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  file.write((uint8_t*)&hdr, sizeof(hdr));
+
+  // Allocate input and output buffers
+  uint8_t *chunk = (uint8_t *)eibiAlloc(EIBI_CHUNK_SIZE);
+  EibiEntry *batch = (EibiEntry *)eibiAlloc(EIBI_RUN_SIZE * sizeof(EibiEntry));
+  if(!chunk || !batch || !eibiInitGzip())
+  {
+    eibiProgress.message = "Out of memory!";
+    eibiFreeGzip();
+    if(chunk) free(chunk);
+    if(batch) free(batch);
+    eibiFreeNames();
+    file.close();
+    http.end();
+    return(EIBI_LOAD_FAILED);
   }
 
   // Start loading data
   WiFiClient *stream = http.getStreamPtr();
   int totalLen = http.getSize();
-  int byteCnt, lineCnt, charCnt;
-  char charBuf[200];
+  int byteCnt;
+  bool inflated = true;
+  uint32_t startTime = millis();
+  uint32_t parseTime = 0;
+
+  memset(&eibiParser, 0, sizeof(eibiParser));
+  eibiParser.batch  = batch;
+  eibiParser.result = true;
+  eibiGzip.state    = http.header(encodingHeader).indexOf("gzip")>=0? EIBI_GZIP_HEADER : EIBI_GZIP_DETECT;
+  eibiGzip.pos      = 0;
+  eibiGzip.skip     = 0;
+  eibiGzip.flags    = 0;
+  eibiGzip.crc      = 0;
+  eibiGzip.size     = 0;
+  eibiProgress.message = 0;
+
+  for(byteCnt = 0 ; inflated && eibiParser.result && http.connected() && (totalLen<0 || byteCnt<totalLen) ; )
+  {
+    // Read as much data as available, up to the chunk size
+    int chunkLen = stream->available();
+    if(chunkLen<=0)
+    {
+      delay(1);
+      continue;
+    }
+
+    chunkLen = stream->read(chunk, chunkLen < EIBI_CHUNK_SIZE? chunkLen : EIBI_CHUNK_SIZE);
+    if(chunkLen<=0) continue;
+    byteCnt += chunkLen;
+
+    // Decompress data if needed, then parse it
+    uint32_t parseStart = micros();
+    inflated = eibiInflate(chunk, chunkLen);
+    parseTime += micros() - parseStart;
+
+    // Report progress
+    eibiProgress.bytes   = byteCnt;
+    eibiProgress.entries = eibiParser.lineCnt;
+  }
+
+  // Compressed data must not end prematurely
+  inflated &= eibiGzipComplete();
+
+  // Neither must the body, if its length is known
+  bool complete = totalLen<0 || byteCnt>=totalLen;
+
+  // Collect parser results
+  int lineCnt  = eibiParser.lineCnt;
+  int batchCnt = eibiParser.batchCnt;
+  int runCnt   = eibiParser.runCnt;
+  bool result  = eibiParser.result && inflated && complete;
+  eibiFreeGzip();
 
-  for(byteCnt = charCnt = lineCnt = 0 ; http.connected() && (totalLen<0 || byteCnt<totalLen) ; )
+  // Done with the input data
+  free(chunk);
+
+  // Name IDs of sorted entries, for the search index
+  uint16_t *entryNames = (uint16_t *)eibiAlloc((lineCnt + 1) * sizeof(uint16_t));
+  result &= !!entryNames;
+
+  int first = 0;
+  if(result && !runCnt)
   {
-    if(!stream->available()) delay(1);
-    else
+    // All entries fit into memory, sort and write them directly
+    batchCnt = eibiSortRun(batch, batchCnt);
+    size_t size = batchCnt * sizeof(EibiEntry);
+    result = file.write((uint8_t*)batch, size) == size;
+    lineCnt = batchCnt;
+    for(int j=0 ; j<batchCnt ; ++j) entryNames[j] = batch[j].name;
+  }
+  else if(result)
+  {
+    eibiProgress.message = "Sorting...";
+
+    // Spill remaining entries into the last run
+    if(batchCnt) result = eibiWriteRun(batch, batchCnt, runCnt++);
+
+    // Merge runs until few enough are left for the final pass
+    while(result && runCnt - first > EIBI_MERGE_WAYS)
     {
-      char c = stream->read();
-      byteCnt++;
+      char path[32];
+      eibiRunPath(path, runCnt);
+      fs::File run = LittleFS.open(path, "wb");
+      result = run && eibiMergeRuns(run, first, EIBI_MERGE_WAYS, batch, EIBI_RUN_SIZE) >= 0;
+      if(run) run.close();
+      first += EIBI_MERGE_WAYS;
+      runCnt++;
+    }
 
-      if(c!='\n' && charCnt<sizeof(charBuf)-1) charBuf[charCnt++] = c;
-      else
-      {
-        char *p, *t;
-
-        // Remove whitespace
-        charBuf[charCnt] = '\0';
-        for(p = charBuf ; *p && *p<=' ' ; ++p);
-        for(t = charBuf + charCnt - 1 ; t>=p && *t<=' ' ; *t--='\0');
-
-        // If valid non-empty schedule line...
-        if(t-p+1>0 && isdigit(*p))
-        {
-          // Remove LFs
-          for(t = p ; *t ; ++t)
-            if(*t=='\r') *t = ' ';
-
-          // If parsed a new entry...
-          StationSchedule entry;
-          if(eibiParseLine(p, entry))
-          {
-            // Write it to the output file
-            file.write((uint8_t*)&entry, sizeof(entry));
-            lineCnt++;
-
-            if(!(lineCnt & 31))
-            {
-              char statusMessage[64];
-              sprintf(statusMessage, "... %d bytes, %d entries ...", byteCnt, lineCnt);
-              drawScreen(eibiMessage, statusMessage);
-            }
-          }
-        }
-
-        // Done with the current buffer, start a new one
-        charCnt = 0;
-        if(c!='\n') charBuf[charCnt++] = c;
-      }
+    // Merge remaining runs into the output file
+    if(result)
+    {
+      lineCnt = eibiMergeRuns(file, first, runCnt - first, batch, EIBI_RUN_SIZE, entryNames);
+      result  = lineCnt >= 0;
+      first   = runCnt;
     }
   }
 
+  // Remove any runs left behind by a failure
+  for(char path[32] ; first < runCnt ; ++first)
+  {
+    eibiRunPath(path, first);
+    LittleFS.remove(path);
+  }
+
+  free(batch);
+
+  // Write station name table, followed by the search index
+  hdr.nameOffset = file.position();
+  hdr.nameSize   = eibiNames.count * sizeof(uint32_t) + eibiNames.size;
+  if(result)
+  {
+    file.write((uint8_t*)eibiNames.offsets, eibiNames.count * sizeof(uint32_t));
+    file.write((uint8_t*)eibiNames.data, eibiNames.size);
+    result = eibiWriteSearchIndex(file, entryNames, lineCnt, hdr);
+  }
+
+  if(entryNames) free(entryNames);
+
+  if(!result)
+  {
+    eibiProgress.message =
+      !complete? "Download incomplete!"
+    : !inflated? "Failed decompressing data!"
+    : "Failed writing local storage!";
+    eibiFreeNames();
+    file.close();
+    http.end();
+    LittleFS.remove(TEMP_PATH);
+    return(EIBI_LOAD_FAILED);
+  }
+
+  // Write the header
+  memcpy(hdr.magic, EIBI_MAGIC, sizeof(hdr.magic));
+  hdr.version    = EIBI_VERSION;
+  hdr.names      = eibiNames.count;
+  hdr.entries    = lineCnt;
+  file.seek(0, fs::SeekSet);
+  file.write((uint8_t*)&hdr, sizeof(hdr));
+  eibiFreeNames();
+
   // Done with file and HTTP connection
   file.close();
   http.end();
 
-  // Move new schedule to its permanent place
-  LittleFS.remove(EIBI_PATH);
-  LittleFS.rename(TEMP_PATH, EIBI_PATH);
+  // Keep import timing for eibiBenchmark()
+  eibiImport.bytes     = byteCnt;
+  eibiImport.time      = millis() - startTime;
+  eibiImport.parseTime = parseTime / 1000;
+
+  // New schedule is ready to replace the current one
+  static char done[32];
+  sprintf(done, "DONE! %uKB in %us",
+    (unsigned int)(eibiImport.bytes / 1024), (unsigned int)(eibiImport.time / 1000));
+  eibiProgress.message = done;
+  return(EIBI_LOAD_READY);
+}
+
+static void eibiLoadTask(void *arg)
+{
+  uint8_t state = eibiDownload();
+
+  // Make sure all results are visible before changing state
+  __sync_synchronize();
+  eibiProgress.state = state;
+  vTaskDelete(NULL);
+}
+
+//
+// Start loading schedule in the background
+//
+bool eibiLoadSchedule()
+{
+  // Can only load one schedule at a time
+  if(eibiLoading()) return(false);
+
+  // Need to be connected to the network
+  if(getWiFiStatus() < 2) return(false);
+
+  // Only ask for changes if the current schedule is valid
+  eibiReadTags(eibiTags.etag, eibiTags.modified, sizeof(eibiTags.etag));
+
+  eibiProgress.message = "Connecting...";
+  eibiProgress.bytes   = 0;
+  eibiProgress.entries = 0;
+  eibiProgress.state   = EIBI_LOAD_RUNNING;
+
+  // Download on core 0, leaving core 1 to the main loop
+  if(xTaskCreatePinnedToCore(eibiLoadTask, "EiBi", EIBI_TASK_STACK, NULL, 1, NULL, 0) != pdPASS)
+  {
+    eibiProgress.message = "Out of memory!";
+    eibiProgress.state   = EIBI_LOAD_FAILED;
+    return(false);
+  }
 
-  // Success
-  identifyFrequency(currentFrequency + currentBFO / 1000);
-  drawScreen(eibiMessage, "DONE!");
   return(true);
 }
+
+bool eibiLoading()
+{
+  return(eibiProgress.state==EIBI_LOAD_RUNNING || eibiProgress.state==EIBI_LOAD_READY);
+}
+
+//
+// Get schedule loading status, return NULL if not loading
+//
+const char *eibiLoadStatus()
+{
+  static char status[64];
+
+  if(eibiProgress.state==EIBI_LOAD_IDLE) return(NULL);
+  if(eibiProgress.message) return(eibiProgress.message);
+
+  sprintf(status, "... %u bytes, %u entries ...",
+    (unsigned int)eibiProgress.bytes, (unsigned int)eibiProgress.entries);
+  return(status);
+}
+
+//
+// Install loaded schedule and update status, return true if the
+// status line needs to be redrawn
+//
+bool eibiTickTime()
+{
+  static uint32_t lastBytes = 0;
+  static uint32_t statusTime = 0;
+
+  switch(eibiProgress.state)
+  {
+    case EIBI_LOAD_RUNNING:
+      // Redraw as download progresses, but not more than 4 times a second
+      if(eibiProgress.bytes != lastBytes && millis() - statusTime >= 250)
+      {
+        lastBytes = eibiProgress.bytes;
+        statusTime = millis();
+        return(true);
+      }
+      return(false);
+
+    case EIBI_LOAD_READY:
+    {
+      EibiLock lock;
+
+      // Move new schedule to its permanent place, replacing the
+      // old one (LittleFS renames atomically)
+      eibiClose();
+      LittleFS.remove(TAGS_PATH);
+      if(!LittleFS.rename(TEMP_PATH, EIBI_PATH))
+      {
+        LittleFS.remove(EIBI_PATH);
+        LittleFS.rename(TEMP_PATH, EIBI_PATH);
+      }
+      eibiWriteTags(eibiTags.etag, eibiTags.modified);
+
+      // Reopen new schedule and rebuild its sparse index
+      eibiBuildIndex();
+      clearFrequencyCache();
+      identifyFrequency(currentFrequency + currentBFO / 1000);
+      eibiProgress.state = EIBI_LOAD_FINISHED;
+      statusTime = millis();
+      return(true);
+    }
+
+    case EIBI_LOAD_UNCHANGED:
+    case EIBI_LOAD_FAILED:
+      eibiProgress.state = EIBI_LOAD_FINISHED;
+      statusTime = millis();
+      return(true);
+
+    case EIBI_LOAD_FINISHED:
+      // Keep showing final status for a while
+      if(millis() - statusTime < EIBI_STATUS_TIME) return(false);
+      eibiProgress.state = EIBI_LOAD_IDLE;
+      lastBytes = 0;
+      return(true);
+  }
+
+  return(false);
+}
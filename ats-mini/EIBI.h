@@ -1,13 +1,6 @@
 #ifndef EIBI_H
 #define EIBI_H
 
-struct BandLabel
-{
-  uint16_t freq_start;  // Starting frequency
-  uint16_t freq_end;    // Ending frequency
-  const char *name;     // Band name
-};
-
 struct StationSchedule
 {
   uint16_t freq;        // Frequency in kHz
@@ -18,11 +11,27 @@ struct StationSchedule
   char     name[32];    // Station name (UTF-8)
 };
 
+typedef struct
+{
+  uint32_t lookups;     // Frequency lookups per second
+  uint32_t seekTime;    // Average schedule seek time (us)
+  uint32_t maxSeek;     // Longest schedule seek (us)
+  uint32_t rebuildTime; // Longest on-air view rebuild (ms)
+  uint32_t importBytes; // Bytes received by the last import
+  uint32_t importTime;  // Duration of the last import (ms)
+  uint32_t parseTime;   // Time the last import spent parsing (ms)
+} EibiStats;
+
 bool eibiAvailable();
 bool eibiLoadSchedule();
+bool eibiLoading();
+bool eibiTickTime();
+const char *eibiLoadStatus();
 const StationSchedule *eibiLookup(uint16_t freq, uint8_t hour, uint8_t minute, size_t *offset=NULL);
 const StationSchedule *eibiPrev(uint16_t freq, uint8_t hour, uint8_t minute, size_t *offset);
 const StationSchedule *eibiNext(uint16_t freq, uint8_t hour, uint8_t minute, size_t *offset);
 const StationSchedule *eibiAtSameFreq(uint8_t hour, uint8_t minute, size_t *offset, bool same);
+const EibiStats *eibiBenchmark();
+int eibiSearch(const char *query, uint8_t hour, uint8_t minute, StationSchedule *results, int maxResults, int *onAir = NULL);
 
 #endif // EIBI_H
@@ -0,0 +1,106 @@
+#include "Common.h"
+
+#define ENCODER_EVENTS    32  // Event ring size (power of two)
+#define ENCODER_IDLE_TIME 200 // Pause restarting spin velocity (ms)
+
+typedef struct
+{
+  uint32_t time; // millis() at the detent
+  int8_t   dir;  // 1 = clockwise, -1 = counter-clockwise
+} EncoderEvent;
+
+//
+// Tuning step multipliers for fast spins, by smoothed time between
+// detents (ms), fastest first
+//
+static const struct
+{
+  uint16_t interval;
+  uint8_t  accel;
+} encoderAccel[] =
+{
+  { 15, 8 },
+  { 30, 4 },
+  { 60, 2 },
+};
+
+//
+// Detents are pushed by the encoder interrupt and popped by the main
+// loop. Head is only written by the interrupt and tail only by the
+// main loop, so no locking is needed.
+//
+static EncoderEvent encoderEvents[ENCODER_EVENTS];
+static uint32_t encoderHead = 0;
+static uint32_t encoderTail = 0;
+
+// Spin velocity state, main loop only
+static uint32_t encoderInterval = ENCODER_IDLE_TIME;
+static uint32_t encoderLastTime = 0;
+static int8_t   encoderLastDir  = 0;
+
+//
+// Push a detent from the encoder interrupt, dropping it if the
+// main loop has fallen a full ring behind
+//
+ICACHE_RAM_ATTR void encoderPushFromISR(int8_t dir)
+{
+  uint32_t head = __atomic_load_n(&encoderHead, __ATOMIC_RELAXED);
+
+  if(head - __atomic_load_n(&encoderTail, __ATOMIC_ACQUIRE) >= ENCODER_EVENTS)
+    return;
+
+  EncoderEvent *event = &encoderEvents[head % ENCODER_EVENTS];
+  event->time = millis();
+  event->dir  = dir;
+
+  __atomic_store_n(&encoderHead, head + 1, __ATOMIC_RELEASE);
+}
+
+bool encoderPending()
+{
+  return(__atomic_load_n(&encoderHead, __ATOMIC_ACQUIRE) != encoderTail);
+}
+
+static uint8_t encoderGetAccel(uint32_t interval)
+{
+  for(int j=0 ; j<ITEM_COUNT(encoderAccel) ; j++)
+    if(interval < encoderAccel[j].interval) return(encoderAccel[j].accel);
+
+  return(1);
+}
+
+//
+// Pop all pending detents, returning their net count. If steps is
+// given, it receives the net number of tuning steps, with each
+// detent multiplied according to the spin velocity at the time.
+//
+int encoderRead(int *steps)
+{
+  uint32_t head = __atomic_load_n(&encoderHead, __ATOMIC_ACQUIRE);
+  uint32_t tail = encoderTail;
+  int count = 0, accelSteps = 0;
+
+  for( ; tail != head ; tail++)
+  {
+    const EncoderEvent *event = &encoderEvents[tail % ENCODER_EVENTS];
+    uint32_t interval = event->time - encoderLastTime;
+
+    // Pausing or reversing starts over at normal speed
+    if((event->dir != encoderLastDir) || (interval >= ENCODER_IDLE_TIME))
+      encoderInterval = ENCODER_IDLE_TIME;
+    else
+      encoderInterval = (encoderInterval + interval) / 2;
+
+    encoderLastTime = event->time;
+    encoderLastDir  = event->dir;
+
+    count      += event->dir;
+    accelSteps += event->dir * encoderGetAccel(encoderInterval);
+  }
+
+  // Release consumed slots to the interrupt
+  __atomic_store_n(&encoderTail, tail, __ATOMIC_RELEASE);
+
+  if(steps) *steps = accelSteps;
+  return(count);
+}
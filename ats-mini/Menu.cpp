@@ -82,6 +82,7 @@ Band *getCurrentBand() { return(&bands[bandIdx]); }
 #define MENU_SOFTMUTE    10
 #define MENU_SETTINGS    11
 #define MENU_SCAN        12
+#define MENU_MAP         13
 
 int8_t menuIdx = MENU_VOLUME;
 
@@ -99,7 +100,8 @@ static const char *menu[] =
   "AVC",
   "SoftMute",
   "Settings",
-//  "Scan",
+  "Scan",
+  "Map",
 };
 
 //
@@ -449,18 +451,29 @@ static void setBandwidth()
   }
 }
 
+static bool seekModeAvailable(uint8_t mode)
+{
+  switch(mode)
+  {
+    // Schedule is not used on FM and needs valid time
+    case SEEK_SCHEDULE: return(currentMode != FM && eibiAvailable() && clockAvailable());
+    // Stations need a scan of the current band
+    case SEEK_STATIONS: return(scanGetStations() > 0);
+    default:            return(true);
+  }
+}
+
 // Seek mode. Pass true to toggle, false to return the current one
 uint8_t seekMode(bool toggle)
 {
   static uint8_t mode = SEEK_DEFAULT;
 
-  mode = toggle ? (mode == SEEK_DEFAULT ? SEEK_SCHEDULE : SEEK_DEFAULT) : mode;
+  // Switch to the next available mode
+  if(toggle)
+    do mode = (mode + 1) % 3; while(!seekModeAvailable(mode));
 
-  // Use normal seek on FM or if there is no schedule loaded
-  if(currentMode == FM || !eibiAvailable() || !clockAvailable())
-    return(SEEK_DEFAULT);
-
-  return(mode);
+  // Use normal seek if the selected mode is not available
+  return(seekModeAvailable(mode) ? mode : SEEK_DEFAULT);
 }
 
 //
@@ -705,7 +718,7 @@ void doAgc(int dir)
   agcNdx     = agcIdx>1? agcIdx - 1 : 0;
 
   // Configure SI4732/5 (if agcNdx = 0, no attenuation)
-  rx.setAutomaticGainControl(disableAgc, agcNdx);
+  radioSetAgc(disableAgc, agcNdx);
 }
 
 void doMode(int dir)
@@ -817,10 +830,16 @@ static void clickMenu(int cmd, bool shortPress)
       break;
 
     case MENU_SCAN:
-      // Run a band scan around current frequency with the same
-      // step as scale resolution (10kHz for AM, 100kHz for FM)
-      drawMessage("Scanning...");
-      scanRun(currentFrequency, 10);
+      // Scan the whole band at the seek spacing of the current
+      // step, coarse first, results are drawn on the scale as they
+      // arrive
+      if(!scanStart(getCurrentStep()->spacing, true)) drawMessage("Not enough memory!");
+      break;
+
+    case MENU_MAP:
+      // Map the band with the radio's own seek, which only finds
+      // stations but is quicker than scanning. No seek in SSB modes.
+      if(!isSSB() && !scanMap(getCurrentStep()->spacing)) drawMessage("Not enough memory!");
       break;
   }
 }
@@ -1099,6 +1118,12 @@ static void drawSeek(int x, int y, int sx)
     spr.drawLine(40+x+(sx/2), 66+y, 40+x+(sx/2), 66+y-7, TH.menu_param);
     spr.drawLine(40+x+(sx/2), 66+y, 40+x+(sx/2)+4, 66+y+4, TH.menu_param);
   }
+  else if(seekMode()==SEEK_STATIONS)
+  {
+    spr.fillRect(40+x+(sx/2)-7, 66+y+2, 3, 5, TH.menu_param);
+    spr.fillRect(40+x+(sx/2)-1, 66+y-2, 3, 9, TH.menu_param);
+    spr.fillRect(40+x+(sx/2)+5, 66+y-7, 3, 14, TH.menu_param);
+  }
 }
 
 static void drawBand(int x, int y, int sx)
@@ -51,6 +51,7 @@
 // Seek modes
 #define SEEK_DEFAULT  0
 #define SEEK_SCHEDULE 1
+#define SEEK_STATIONS 2
 
 //
 // Data Types
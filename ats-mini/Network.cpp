@@ -4,6 +4,7 @@
 #include "Utils.h"
 #include "Menu.h"
 #include "Draw.h"
+#include "EIBI.h"
 
 #include <WiFi.h>
 #include <WiFiUdp.h>
@@ -12,6 +13,7 @@
 #include <NTPClient.h>
 #include <Preferences.h>
 #include <ESPmDNS.h>
+#include <memory>
 
 #define CONNECT_TIME  3000  // Time of inactivity to start connecting WiFi
 
@@ -60,6 +62,7 @@ static const String webUtcOffsetSelector();
 static const String webThemeSelector();
 static const String webRadioPage();
 static const String webMemoryPage();
+static const String webSearchPage(const String &query);
 static const String webConfigPage();
 
 //
@@ -334,6 +337,11 @@ static void webInit()
     request->send(200, "text/html", webMemoryPage());
   });
 
+  server.on("/search", HTTP_ANY, [] (AsyncWebServerRequest *request) {
+    String query = request->hasParam("q")? request->getParam("q")->value() : "";
+    request->send(200, "text/html", webSearchPage(query));
+  });
+
   server.on("/config", HTTP_ANY, [] (AsyncWebServerRequest *request) {
     if(loginUsername != "" && loginPassword != "")
       if(!request->authenticate(loginUsername.c_str(), loginPassword.c_str()))
@@ -341,6 +349,19 @@ static void webInit()
     request->send(200, "text/html", webConfigPage());
   });
 
+  // Scan data can be large, send it line by line as it is read
+  server.on("/scan.csv", HTTP_ANY, [] (AsyncWebServerRequest *request) {
+    std::shared_ptr<ScanExport> state = std::make_shared<ScanExport>();
+    if(!scanExportStart(state.get()))
+      request->send(404, "text/plain", "No scan data");
+    else
+      request->send(request->beginChunkedResponse("text/csv",
+        [state] (uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+          return(scanExportRead(state.get(), buffer, maxLen));
+        }
+      ));
+  });
+
   server.onNotFound([] (AsyncWebServerRequest *request) {
     request->send(404, "text/plain", "Not found");
   });
@@ -596,6 +617,10 @@ static const String webRadioPage()
     String(currentFrequency / 100.0) + "MHz "
   : String(currentFrequency + currentBFO / 1000.0) + "kHz ";
 
+  // Latest signal quality sample, zeros if none yet
+  RadioSample sample = { 0 };
+  radioGetSample(&sample);
+
   if(WiFi.status()==WL_CONNECTED)
   {
     ip = WiFi.localIP().toString();
@@ -610,7 +635,8 @@ static const String webRadioPage()
   return webPage(
 "<H1>ATS-Mini Pocket Receiver</H1>"
 "<P ALIGN='CENTER'>"
-  "<A HREF='/memory'>Memory</A>&nbsp;|&nbsp;<A HREF='/config'>Config</A>"
+  "<A HREF='/memory'>Memory</A>&nbsp;|&nbsp;<A HREF='/search'>Search</A>"
+  "&nbsp;|&nbsp;<A HREF='/config'>Config</A>"
 "</P>"
 "<TABLE COLUMNS=2>"
 "<TR>"
@@ -635,11 +661,11 @@ static const String webRadioPage()
 "</TR>"
 "<TR>"
   "<TD CLASS='LABEL'>Signal Strength</TD>"
-  "<TD>" + String(rssi) + "dBuV</TD>"
+  "<TD>" + String(sample.rssi) + "dBuV</TD>"
 "</TR>"
 "<TR>"
   "<TD CLASS='LABEL'>Signal to Noise</TD>"
-  "<TD>" + String(snr) + "dB</TD>"
+  "<TD>" + String(sample.snr) + "dB</TD>"
 "</TR>"
 "<TR>"
   "<TD CLASS='LABEL'>Battery Voltage</TD>"
@@ -673,12 +699,70 @@ static const String webMemoryPage()
   return webPage(
 "<H1>ATS-Mini Pocket Receiver Memory</H1>"
 "<P ALIGN='CENTER'>"
-  "<A HREF='/'>Status</A>&nbsp;|&nbsp;<A HREF='/config'>Config</A>"
+  "<A HREF='/'>Status</A>&nbsp;|&nbsp;<A HREF='/search'>Search</A>"
+  "&nbsp;|&nbsp;<A HREF='/config'>Config</A>"
 "</P>"
 "<TABLE COLUMNS=2>" + items + "</TABLE>"
 );
 }
 
+static const String webSearchPage(const String &query)
+{
+  StationSchedule results[32];
+  String items = "";
+  uint8_t hour, minute;
+  int onAir = 0;
+  int count = 0;
+
+  // Stations on air are listed first, if the time is known
+  if(!clockGetHM(&hour, &minute)) hour = 24;
+  if(query != "")
+    count = eibiSearch(query.c_str(), hour, minute, results, ITEM_COUNT(results), &onAir);
+
+  for(int j=0 ; j<count ; j++)
+  {
+    char text[96];
+    snprintf(text, sizeof(text), "<TR><TD CLASS='LABEL' WIDTH='20%%'>%ukHz</TD><TD>%02d:%02d-%02d:%02d%s</TD><TD>",
+      results[j].freq,
+      results[j].start_h, results[j].start_m,
+      results[j].end_h, results[j].end_m,
+      j<onAir? " (on air)" : ""
+    );
+
+    String name(results[j].name);
+    name.replace("&", "&amp;");
+    name.replace("<", "&lt;");
+    name.replace(">", "&gt;");
+    items += String(text) + name + "</TD></TR>";
+  }
+
+  if(query != "" && !count)
+    items = eibiAvailable()?
+      "<TR><TD>&nbsp;---&nbsp;</TD></TR>"
+    : "<TR><TD>No schedule loaded</TD></TR>";
+
+  return webPage(
+"<H1>ATS-Mini Station Search</H1>"
+"<P ALIGN='CENTER'>"
+  "<A HREF='/'>Status</A>"
+  "&nbsp;|&nbsp;<A HREF='/memory'>Memory</A>"
+  "&nbsp;|&nbsp;<A HREF='/config'>Config</A>"
+"</P>"
+"<FORM ACTION='/search' METHOD='GET'>"
+  "<TABLE COLUMNS=2>"
+  "<TR>"
+    "<TD CLASS='LABEL'>Station</TD>"
+    "<TD>" + webInputField("q", query) + "</TD>"
+  "</TR>"
+  "<TR><TH COLSPAN=2 CLASS='HEADING'>"
+    "<INPUT TYPE='SUBMIT' VALUE='Search'>"
+  "</TH></TR>"
+  "</TABLE>"
+"</FORM>"
+"<TABLE COLUMNS=3>" + items + "</TABLE>"
+);
+}
+
 const String webConfigPage()
 {
   preferences.begin("configData", true);
@@ -695,6 +779,7 @@ const String webConfigPage()
 "<P ALIGN='CENTER'>"
   "<A HREF='/'>Status</A>"
   "&nbsp;|&nbsp;<A HREF='/memory'>Memory</A>"
+  "&nbsp;|&nbsp;<A HREF='/search'>Search</A>"
 "</P>"
 "<FORM ACTION='/setconfig' METHOD='POST'>"
   "<TABLE COLUMNS=2>"
@@ -0,0 +1,329 @@
+#include "Common.h"
+
+#define RADIO_QUEUE_SIZE   16    // Maximum number of pending commands
+#define RADIO_TASK_STACK   4096  // Radio task stack size
+#define RADIO_SAMPLE_TIME  100   // Default signal quality sampling period (ms)
+#define RADIO_SAMPLE_MIN   10    // Shortest signal quality sampling period (ms)
+#define RADIO_SAMPLES      16    // Number of signal quality samples kept
+#define RADIO_TUNE_TIME    100   // Maximum time to wait for tuning (ms)
+
+#define RADIO_TUNE    0 // Tune to the latest target frequency
+#define RADIO_BFO     1 // Set SSB BFO offset
+#define RADIO_AGC     2 // Set AGC/attenuator
+
+typedef struct
+{
+  uint8_t type;
+  union
+  {
+    int16_t  bfo;
+    struct
+    {
+      uint8_t disable;
+      uint8_t idx;
+    } agc;
+  };
+} RadioCommand;
+
+//
+// The radio task owns the I2C bus while the main loop draws or
+// sleeps. The main loop holds radioMutex while it handles input and
+// timers, which may still talk to the radio directly. Taking the lock
+// executes commands queued so far, but commands queued while holding
+// it wait for the next pass. Code talking to the radio directly after
+// queueing commands in the same pass calls radioSync() first.
+//
+static SemaphoreHandle_t radioMutex = xSemaphoreCreateRecursiveMutex();
+static QueueHandle_t radioQueue = 0;
+
+//
+// Signal quality samples are kept in a ring, sample number radioSeq
+// being the latest one. A new sample is written into the next slot
+// before radioSeq is incremented, so readers never see it half-done.
+//
+static RadioSample radioSamples[RADIO_SAMPLES];
+static uint32_t radioSeq = 0;
+static uint32_t radioSampleTime = 0;
+static uint16_t radioSamplePeriod = RADIO_SAMPLE_TIME;
+
+//
+// Tuning target is a single slot rather than a queued command, so
+// that a newer target replaces any pending one. Once tuning starts,
+// completion is polled, and a newer target cancels the tuning.
+//
+static uint16_t radioTarget = 0;     // Latest target, 0 if none
+static uint32_t radioTargetTime = 0; // millis() when target was set
+static uint16_t radioTuning = 0;     // Frequency being tuned to, 0 if none
+static uint32_t radioTuneStart = 0;  // millis() when tuning started
+static uint32_t radioTuneTarget = 0; // radioTargetTime of that target
+static RadioStats radioStats;
+
+//
+// Read RSQ status into the ring, with radioMutex held. This is the
+// only place reading signal quality from the radio.
+//
+static const RadioSample *radioSample()
+{
+  uint32_t seq = __atomic_load_n(&radioSeq, __ATOMIC_RELAXED);
+  RadioSample *sample = &radioSamples[(seq + 1) % RADIO_SAMPLES];
+
+  rx.getCurrentReceivedSignalQuality();
+  sample->time   = millis();
+  sample->freq   = rx.getCurrentFrequency();
+  sample->rssi   = rx.getCurrentRSSI();
+  sample->snr    = rx.getCurrentSNR();
+  sample->offset = rx.getCurrentSignedFrequencyOffset();
+  sample->stereo = rx.getCurrentPilot();
+  sample->valid  = rx.getCurrentValidChannel();
+
+  __atomic_store_n(&radioSeq, seq + 1, __ATOMIC_RELEASE);
+  radioSampleTime = sample->time;
+  return(sample);
+}
+
+//
+// Start tuning to the latest target, cancelling unfinished tuning
+//
+static void radioStartTune()
+{
+  uint16_t freq = __atomic_exchange_n(&radioTarget, 0, __ATOMIC_ACQ_REL);
+  if(!freq) return;
+
+  if(radioTuning)
+  {
+    rx.getStatus(1, 1);
+    radioStats.dropped++;
+  }
+  else
+  {
+    // Clear stale tune completion status first
+    rx.getStatus(1, 0);
+  }
+
+  rx.setFrequencyNoWait(freq);
+  radioTuning     = freq;
+  radioTuneStart  = millis();
+  radioTuneTarget = radioTargetTime;
+}
+
+//
+// Check if tuning has completed, sampling signal quality at the
+// new frequency once it has
+//
+static void radioCheckTune()
+{
+  rx.getStatus(0, 0);
+  if(!rx.getTuneCompleteTriggered() && (millis() - radioTuneStart < RADIO_TUNE_TIME))
+    return;
+
+  uint32_t latency = radioSample()->time - radioTuneTarget;
+  radioStats.tunes++;
+  radioStats.latency    = latency;
+  radioStats.maxLatency = max(latency, radioStats.maxLatency);
+  radioTuning = 0;
+}
+
+static void radioExecute(const RadioCommand *cmd)
+{
+  switch(cmd->type)
+  {
+    case RADIO_TUNE:
+      radioStartTune();
+      break;
+    case RADIO_BFO:
+      rx.setSSBBfo(cmd->bfo);
+      break;
+    case RADIO_AGC:
+      rx.setAutomaticGainControl(cmd->agc.disable, cmd->agc.idx);
+      break;
+  }
+}
+
+//
+// Execute all pending commands, with radioMutex held
+//
+static void radioFlush()
+{
+  RadioCommand cmd;
+
+  while(radioQueue && (xQueueReceive(radioQueue, &cmd, 0) == pdTRUE))
+    radioExecute(&cmd);
+}
+
+static void radioTask(void *param)
+{
+  RadioCommand cmd;
+
+  while(true)
+  {
+    // Wait for a command, polling tuning or sampling signal quality
+    // in between. Commands are left queued, so that they execute in
+    // order, even if the main loop flushes the queue first.
+    uint32_t wait = radioTuning? 1 : radioSamplePeriod;
+    xQueuePeek(radioQueue, &cmd, pdMS_TO_TICKS(wait));
+
+    xSemaphoreTakeRecursive(radioMutex, portMAX_DELAY);
+
+    radioFlush();
+
+    // Signal quality is sampled once tuning completes. Scan
+    // measures signal quality itself.
+    if(radioTuning)
+      radioCheckTune();
+    else if(!scanIsRunning() && (millis() - radioSampleTime >= radioSamplePeriod))
+      radioSample();
+
+    xSemaphoreGiveRecursive(radioMutex);
+  }
+}
+
+//
+// Queue a command, or execute it right away if the radio task is
+// not running yet or the queue is full. The main loop may hold the
+// radio while the queue is full, so never wait for free space.
+//
+static void radioSend(const RadioCommand *cmd)
+{
+  if(radioQueue && (xQueueSend(radioQueue, cmd, 0) == pdTRUE))
+    return;
+
+  radioLock();
+  radioExecute(cmd);
+  radioUnlock();
+}
+
+//
+// Start radio task on core 0, leaving core 1 to the main loop
+//
+bool radioInit()
+{
+  if(radioQueue) return(true);
+
+  radioQueue = xQueueCreate(RADIO_QUEUE_SIZE, sizeof(RadioCommand));
+  if(!radioQueue) return(false);
+
+  if(xTaskCreatePinnedToCore(radioTask, "Radio", RADIO_TASK_STACK, NULL, 2, NULL, 0) != pdPASS)
+  {
+    vQueueDelete(radioQueue);
+    radioQueue = 0;
+    return(false);
+  }
+
+  return(true);
+}
+
+//
+// Take the radio for direct access, executing pending commands
+// first so that they apply in order
+//
+void radioLock()
+{
+  xSemaphoreTakeRecursive(radioMutex, portMAX_DELAY);
+  radioFlush();
+}
+
+void radioUnlock()
+{
+  xSemaphoreGiveRecursive(radioMutex);
+}
+
+//
+// Execute pending commands right away, before direct access
+//
+void radioSync()
+{
+  radioLock();
+  radioUnlock();
+}
+
+//
+// Set new tuning target. Only the first of several targets set
+// before tuning starts is queued, tuning then goes straight to the
+// latest one, dropping the rest.
+//
+void radioTune(uint16_t freq)
+{
+  radioTargetTime = millis();
+  if(__atomic_exchange_n(&radioTarget, freq, __ATOMIC_ACQ_REL))
+  {
+    radioStats.dropped++;
+    return;
+  }
+
+  RadioCommand cmd = { RADIO_TUNE };
+  radioSend(&cmd);
+}
+
+void radioSetBFO(int16_t bfo)
+{
+  RadioCommand cmd = { RADIO_BFO };
+  cmd.bfo = bfo;
+  radioSend(&cmd);
+}
+
+void radioSetAgc(uint8_t disable, uint8_t idx)
+{
+  RadioCommand cmd = { RADIO_AGC };
+  cmd.agc.disable = disable;
+  cmd.agc.idx     = idx;
+  radioSend(&cmd);
+}
+
+//
+// Set signal quality sampling period (ms, 0 = default), returning
+// the period actually set
+//
+uint16_t radioSetSampleTime(uint16_t period)
+{
+  radioSamplePeriod = !period? RADIO_SAMPLE_TIME : period<RADIO_SAMPLE_MIN? RADIO_SAMPLE_MIN : period;
+  return(radioSamplePeriod);
+}
+
+//
+// Sample signal quality right away, e.g. to measure a scan point as
+// soon as tuning completes, adding the sample to the ring
+//
+RadioSample radioMeasure()
+{
+  radioLock();
+  RadioSample sample = *radioSample();
+  radioUnlock();
+  return(sample);
+}
+
+//
+// Copy a sample taken given number of samples ago (0 = latest),
+// without locking, returning FALSE if there is no such sample
+//
+bool radioGetSample(RadioSample *sample, uint8_t age)
+{
+  uint32_t seq;
+
+  // The slot after the latest sample may be getting written
+  if(age >= RADIO_SAMPLES - 1) return(false);
+
+  // Retry if the slot has been reused while copying
+  do
+  {
+    seq = __atomic_load_n(&radioSeq, __ATOMIC_ACQUIRE);
+    if(seq <= age) return(false);
+    *sample = radioSamples[(seq - age) % RADIO_SAMPLES];
+  }
+  while(__atomic_load_n(&radioSeq, __ATOMIC_ACQUIRE) - seq >= (uint32_t)(RADIO_SAMPLES - 1 - age));
+
+  return(true);
+}
+
+//
+// Return TRUE if the latest sample shows FM stereo pilot
+//
+bool radioGetStereo()
+{
+  RadioSample sample;
+  return(radioGetSample(&sample) && sample.stereo);
+}
+
+const RadioStats *radioGetStats()
+{
+  return(&radioStats);
+}
@@ -3,10 +3,10 @@
 #include "Utils.h"
 #include "Menu.h"
 #include "Draw.h"
+#include "EIBI.h"
 
 #ifndef DISABLE_REMOTE
 
-static uint32_t remoteTimer = millis();
 static uint8_t remoteSeqnum = 0;
 static bool remoteLogOn = false;
 
@@ -254,6 +254,132 @@ static void remoteSetColorTheme()
   drawScreen();
 }
 
+//
+// Search schedule for stations with given name, printing
+// frequency, time, on air flag, and name of each result
+//
+static bool remoteFindStation()
+{
+  Serial.print('F');
+  StationSchedule results[16];
+  char query[32];
+  uint8_t hour, minute;
+  int onAir;
+
+  readSerialString(query, sizeof(query));
+  if (!expectNewline())
+    return showError("Expected newline");
+  Serial.println();
+
+  if (!eibiAvailable())
+    return showError("No schedule loaded");
+
+  // Stations on air are listed first, if the time is known
+  if (!clockGetHM(&hour, &minute))
+    hour = 24;
+
+  int count = eibiSearch(query, hour, minute, results, ITEM_COUNT(results), &onAir);
+  for (int i = 0; i < count; i++) {
+    Serial.printf("%u,%02d%02d-%02d%02d,%d,%s\r\n",
+                  results[i].freq,
+                  results[i].start_h, results[i].start_m,
+                  results[i].end_h, results[i].end_m,
+                  i < onAir,
+                  results[i].name);
+  }
+
+  return true;
+}
+
+//
+// Print statistics of the last band scan: number of points, total
+// sweep time, average and maximum dwell time per point (ms), and
+// number of points measured without tune completion
+//
+static void remoteScanStats()
+{
+  const ScanStats *stats = scanGetStats();
+
+  Serial.printf("%u,%lu,%lu,%lu,%u\r\n",
+                stats->points,
+                stats->sweepTime,
+                stats->points ? stats->dwellTime / stats->points : 0,
+                stats->maxDwell,
+                stats->timeouts);
+}
+
+//
+// Print latest scan data of the current band
+//
+static bool remoteScanExport()
+{
+  if (!scanPrint(Serial))
+    return showError("No scan data");
+
+  return true;
+}
+
+//
+// Print main loop statistics: uptime, total time spent sleeping
+// (ms), and number of main loop passes
+//
+static void remoteLoopStats()
+{
+  const TimerStats *stats = timerGetStats();
+
+  Serial.printf("%lu,%lu,%lu\r\n", millis(), stats->idleTime, stats->wakeups);
+}
+
+//
+// Set signal quality sampling period, e.g. Q50 (ms, 0 = default),
+// effective until a power cycle
+//
+static bool remoteSetSampleTime()
+{
+  Serial.print('Q');
+
+  long int period = readSerialInteger();
+  if (!expectNewline())
+    return showError("Expected newline");
+  if (period < 0 || period > 0xFFFF)
+    return showError("Invalid sampling period");
+  Serial.println();
+
+  Serial.printf("Sampling every %u ms\r\n", radioSetSampleTime(period));
+  return true;
+}
+
+//
+// Print tuning statistics: completed tunings, dropped targets, last
+// and maximum time from setting a target to tuning done (ms)
+//
+static void remoteTuneStats()
+{
+  const RadioStats *stats = radioGetStats();
+
+  Serial.printf("%lu,%lu,%lu,%lu\r\n", stats->tunes, stats->dropped, stats->latency, stats->maxLatency);
+}
+
+//
+// Time schedule access: frequency lookups per second, average and
+// maximum seek time over a whole day (us), and longest on-air view
+// rebuild (ms). Then print bytes received by the last import, its
+// total time and the part of it spent parsing (ms).
+//
+static void remoteEibiStats()
+{
+  const EibiStats *stats = eibiBenchmark();
+
+  Serial.printf("%lu,%lu,%lu,%lu,%lu,%lu,%lu\r\n",
+                stats->lookups,
+                stats->seekTime,
+                stats->maxSeek,
+                stats->rebuildTime,
+                stats->importBytes,
+                stats->importTime,
+                stats->parseTime);
+}
+
 //
 // Print current color theme to the remote
 //
@@ -278,10 +404,9 @@ void remotePrintStatus()
   // Prepare information ready to be sent
   float remoteVoltage = batteryMonitor();
 
-  // S-Meter conditional on compile option
-  rx.getCurrentReceivedSignalQuality();
-  uint8_t remoteRssi = rx.getCurrentRSSI();
-  uint8_t remoteSnr = rx.getCurrentSNR();
+  // Latest signal quality sample, zeros if none yet
+  RadioSample sample = { 0 };
+  radioGetSample(&sample);
 
   // Use rx.getFrequency to force read of capacitor value from SI4732/5
   rx.getFrequency();
@@ -299,8 +424,8 @@ void remotePrintStatus()
                 getCurrentBandwidth()->desc,
                 agcIdx,
                 volume,
-                remoteRssi,
-                remoteSnr,
+                sample.rssi,
+                sample.snr,
                 tuningCapacitor,
                 remoteVoltage,
                 remoteSeqnum
@@ -308,14 +433,14 @@ void remotePrintStatus()
 }
 
 //
-// Tick remote time, periodically printing status
+// Tick remote time, printing status if logging is on (called
+// periodically from the main loop)
 //
 void remoteTickTime()
 {
-  if(remoteLogOn && (millis() - remoteTimer >= 500))
+  if(remoteLogOn)
   {
-    // Mark time and increment diagnostic sequence number
-    remoteTimer = millis();
+    // Increment diagnostic sequence number
     remoteSeqnum++;
     // Show status
     remotePrintStatus();
@@ -427,6 +552,27 @@ int remoteDoCommand(char key)
       if (remoteSetMemory())
         event |= REMOTE_EEPROM;
       break;
+    case 'F':
+      remoteFindStation();
+      break;
+    case 'N':
+      remoteScanStats();
+      break;
+    case 'X':
+      remoteScanExport();
+      break;
+    case 'U':
+      remoteLoopStats();
+      break;
+    case 'K':
+      remoteTuneStats();
+      break;
+    case 'Q':
+      remoteSetSampleTime();
+      break;
+    case 'E':
+      remoteEibiStats();
+      break;
 
     case 'T':
       Serial.println(switchThemeEditor(!switchThemeEditor()) ? "Theme editor enabled" : "Theme editor disabled");
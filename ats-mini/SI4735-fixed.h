@@ -43,6 +43,26 @@ class SI4735_fixed: public SI4735
       return getRdsVersionCode()? SI4735::getRdsText2B() : SI4735::getRdsText2A();
     }
 
+    // Start tuning without waiting, completion can then be polled
+    // with getStatus() and getTuneCompleteTriggered()
+    void setFrequencyNoWait(uint16_t freq)
+    {
+      auto maxDelay = maxDelaySetFrequency;
+      maxDelaySetFrequency = 0;
+      setFrequency(freq);
+      maxDelaySetFrequency = maxDelay;
+    }
+
+    // Frequency reported by the last getStatus() call, i.e. where
+    // tuning or seeking has stopped
+    uint16_t getStatusFrequency(void)
+    {
+      si47x_frequency freq;
+      freq.raw.FREQH = currentStatus.resp.READFREQH;
+      freq.raw.FREQL = currentStatus.resp.READFREQL;
+      return freq.value;
+    }
+
   void seekStationProgress(void (*showFunc)(uint16_t f), bool (*stopSeeking)(), uint8_t up_down)
   {
     si47x_frequency freq;
@@ -1,134 +1,1007 @@
 #include "Common.h"
 #include "Utils.h"
 #include "Menu.h"
+#include <LittleFS.h>
 
-#define SCAN_TIME   100 // Msecs between tuning and reading RSSI
-#define SCAN_POINTS 200 // Number of frequencies to scan
+#define SCAN_HISTORY 16 // Number of past sweeps to keep
+#define SCAN_STATIONS 64 // Maximum number of stations found by a scan
+#define SCAN_NONE  0xFF // SNR value of points not measured yet
+
+// Two pass scans first measure points this far apart (in kHz, or in
+// 10kHz on FM), then revisit neighbourhoods of points above the noise
+// floor at the fine step
+#define SCAN_COARSE_FM     20
+#define SCAN_COARSE_AM     10
+#define SCAN_COARSE_MARGIN 3  // dBuV above the noise floor
+
+// Maximum msecs between tuning and reading RSSI, if the radio does
+// not report tune completion earlier
+#define SCAN_TIME_FM   60
+#define SCAN_TIME_AM   100
+#define SCAN_TIME_SSB  100
+
+// Maximum msecs a single seek may take when mapping the band
+#define SCAN_TIME_SEEK 20000
+
+// Cached scan data older than this is refreshed in the background,
+// one point per SCAN_REFRESH_TIME msecs
+#define SCAN_STALE_TIME   300000
+#define SCAN_REFRESH_TIME 250
+
+// Scan data of each band is saved here, changed data at most once
+// per SCAN_SAVE_TIME msecs
+#define SCAN_CACHE_PATH "/scan.%02d"
+#define SCAN_SAVE_TIME  300000
 
 #define SCAN_OFF    0   // Scanner off, no data
 #define SCAN_RUN    1   // Scanner running
 #define SCAN_DONE   2   // Scanner done, valid data in scanData[]
 
-static struct
+typedef struct
 {
   uint8_t rssi;
   uint8_t snr;
-} scanData[SCAN_POINTS];
+} ScanPoint;
+
+typedef struct
+{
+  uint8_t minRSSI;
+  uint8_t maxRSSI;
+  uint8_t minSNR;
+  uint8_t maxSNR;
+} ScanRange;
+
+typedef struct
+{
+  uint16_t freq;
+  uint8_t  rssi;
+  uint8_t  snr;
+} ScanStation;
+
+//
+// Signal must be this much above the noise floor (dBuV) and have at
+// least this SNR (dB) to be considered a station, by band type
+//
+static const struct
+{
+  uint8_t rssi;
+  uint8_t snr;
+} scanThresholds[] =
+{
+  { 10, 6 }, // FM_BAND_TYPE
+  {  8, 4 }, // MW_BAND_TYPE
+  {  6, 3 }, // SW_BAND_TYPE
+  {  8, 4 }, // LW_BAND_TYPE
+};
+
+//
+// Stations found by the last scan, strongest first
+//
+static ScanStation scanStations[SCAN_STATIONS];
+static uint8_t scanStationCount = 0;
+static const Band *scanBand = 0;
+
+//
+// Sweeps are kept in a ring of scanHistory rows, scanPoints each,
+// with the latest sweep at scanSweep. Max hold keeps the highest
+// RSSI seen at each point since the scan range last changed.
+//
+static ScanPoint *scanData    = 0;
+static uint8_t   *scanMaxHold = 0;
+static uint8_t   *scanPending = 0; // Points to revisit, one bit each
+static uint8_t    scanHistory = 0;
+
+static struct
+{
+  uint16_t  count;        // Number of measured points
+  ScanRange range;        // Range of measured values
+} scanSweeps[SCAN_HISTORY];
+
+//
+// Latest data of each band, with the time each point has been
+// measured at, kept across band changes and saved to LittleFS
+//
+typedef struct
+{
+  uint16_t   start;       // First frequency
+  uint16_t   step;        // Frequency step
+  uint16_t   points;      // Number of points
+  ScanRange  range;       // Range of cached values
+  ScanPoint *data;        // Latest values
+  uint32_t  *stamps;      // millis() when measured (0 = never)
+  bool       loaded;      // TRUE if saved data has been checked
+  bool       dirty;       // TRUE if data has changed since saved
+} ScanCache;
+
+static ScanCache *scanCache = 0;
+static ScanCache *scanCacheNow = 0;
+
+//
+// The web server reads cached data from its own task. Allocating,
+// loading, or reallocating cached data is done with scanMutex held.
+//
+static SemaphoreHandle_t scanMutex = xSemaphoreCreateRecursiveMutex();
+static uint32_t   scanRefreshTime = 0;
+static uint32_t   scanSaveTime = 0;
+static int        scanRefreshPoint = -1; // Point being refreshed, -1 if none
+static uint8_t    scanRefreshBand;       // Band of that point
+static uint16_t   scanRefreshUser;       // Frequency to return to
 
 static uint32_t scanTime = millis();
+static uint32_t scanSweepTime;
 static uint8_t  scanStatus = SCAN_OFF;
+static ScanStats scanStats;
 
+static uint16_t scanUserFreq;
 static uint16_t scanStartFreq;
 static uint16_t scanStep;
-static uint16_t scanCount;
-static uint8_t  scanMinRSSI;
-static uint8_t  scanMaxRSSI;
-static uint8_t  scanMinSNR;
-static uint8_t  scanMaxSNR;
+static uint16_t scanPoints;
+static uint16_t scanCoarse;      // Coarse pass step, in points
+static uint8_t  scanPass;        // 0 = coarse pass, 1 = fine pass
+static int      scanIndex;       // Point being measured
+static uint8_t  scanSweep;
+static uint8_t  scanSweepCount;
+static uint8_t  scanHoldMin;
+static uint8_t  scanHoldMax;
+static bool     scanMapping;     // TRUE when mapping band with seek
+static ScanStation scanMapPeak;  // Strongest of adjacent seek stops
+static uint16_t scanMapLast;     // Last valid seek stop
 
 static inline uint8_t min(uint8_t a, uint8_t b) { return(a<b? a:b); }
 static inline uint8_t max(uint8_t a, uint8_t b) { return(a>b? a:b); }
 
-float scanGetRSSI(uint16_t freq)
+bool scanIsRunning()
 {
-  // Input frequency must be in range of existing data
-  if((scanStatus!=SCAN_DONE) || (freq<scanStartFreq) || (freq>=scanStartFreq+scanStep*scanCount))
-    return(0.0);
+  return(scanStatus==SCAN_RUN);
+}
 
-  uint8_t result = scanData[(freq - scanStartFreq) / scanStep].rssi;
-  return((result - scanMinRSSI) / (float)(scanMaxRSSI - scanMinRSSI + 1));
+const ScanStats *scanGetStats()
+{
+  return(&scanStats);
 }
 
-float scanGetSNR(uint16_t freq)
+uint8_t scanGetHistory()
+{
+  return(scanSweepCount);
+}
+
+static void *scanAlloc(size_t size)
+{
+  return(psramFound()? ps_malloc(size) : malloc(size));
+}
+
+static inline void scanUpdateRange(ScanRange *range, const ScanPoint *point)
+{
+  range->minRSSI = min(point->rssi, range->minRSSI);
+  range->maxRSSI = max(point->rssi, range->maxRSSI);
+  range->minSNR  = min(point->snr, range->minSNR);
+  range->maxSNR  = max(point->snr, range->maxSNR);
+}
+
+static bool scanInitCache(ScanCache *cache, uint16_t start, uint16_t step, uint16_t points)
+{
+  // Keep existing data if possible
+  if(cache->data && (cache->start==start) && (cache->step==step) && (cache->points==points))
+    return(true);
+
+  free(cache->data);
+  free(cache->stamps);
+  cache->data   = (ScanPoint *)scanAlloc(points * sizeof(ScanPoint));
+  cache->stamps = (uint32_t *)scanAlloc(points * sizeof(uint32_t));
+
+  if(!cache->data || !cache->stamps)
+  {
+    free(cache->data);
+    free(cache->stamps);
+    cache->data   = 0;
+    cache->stamps = 0;
+    return(false);
+  }
+
+  cache->start  = start;
+  cache->step   = step;
+  cache->points = points;
+  cache->range  = { 255, 0, 255, 0 };
+  cache->dirty  = false;
+  memset(cache->data, SCAN_NONE, points * sizeof(ScanPoint));
+  memset(cache->stamps, 0, points * sizeof(uint32_t));
+  return(true);
+}
+
+static void scanLoadCache(int band)
+{
+  ScanCache *cache = &scanCache[band];
+  uint16_t hdr[3];
+  char path[16];
+
+  sprintf(path, SCAN_CACHE_PATH, band);
+  if(!LittleFS.exists(path)) return;
+
+  fs::File file = LittleFS.open(path, "rb");
+  if(!file) return;
+
+  // Header contains start, step, and number of points
+  if((file.read((uint8_t *)hdr, sizeof(hdr))==sizeof(hdr)) && hdr[1] && scanInitCache(cache, hdr[0], hdr[1], hdr[2]))
+  {
+    size_t size = hdr[2] * sizeof(ScanPoint);
+    if(file.read((uint8_t *)cache->data, size)==size)
+    {
+      // Loaded data is there to be shown, but should be refreshed
+      for(int j=0 ; j<cache->points ; j++)
+        if(cache->data[j].snr!=SCAN_NONE) scanUpdateRange(&cache->range, &cache->data[j]);
+    }
+    else
+    {
+      free(cache->data);
+      free(cache->stamps);
+      cache->data   = 0;
+      cache->stamps = 0;
+    }
+  }
+
+  file.close();
+}
+
+static void scanSaveCache(int band)
+{
+  ScanCache *cache = &scanCache[band];
+  uint16_t hdr[3] = { cache->start, cache->step, cache->points };
+  size_t size = cache->points * sizeof(ScanPoint);
+  char path[16];
+
+  if(!cache->data) return;
+
+  sprintf(path, SCAN_CACHE_PATH, band);
+  fs::File file = LittleFS.open(path, "wb");
+  if(!file) return;
+
+  bool result = (file.write((uint8_t *)hdr, sizeof(hdr))==sizeof(hdr))
+             && (file.write((uint8_t *)cache->data, size)==size);
+  file.close();
+
+  // Do not leave partial data behind
+  if(result) cache->dirty = false; else LittleFS.remove(path);
+}
+
+//
+// Save changed data of one band, if enough time has passed since
+// the last save, to keep flash writes down
+//
+static void scanSaveTick()
+{
+  if(!scanCache || (millis() - scanSaveTime < SCAN_SAVE_TIME)) return;
+
+  for(int j=0 ; j<getTotalBands() ; j++)
+  {
+    if(scanCache[j].dirty)
+    {
+      scanSaveTime = millis();
+      scanSaveCache(j);
+      return;
+    }
+  }
+}
+
+//
+// Get scan cache for given band, loading saved data on first use
+//
+static ScanCache *scanGetCache(int band)
+{
+  ScanCache *cache = 0;
+
+  xSemaphoreTakeRecursive(scanMutex, portMAX_DELAY);
+
+  if(scanCache || (scanCache = (ScanCache *)calloc(getTotalBands(), sizeof(ScanCache))))
+  {
+    cache = &scanCache[band];
+    if(!cache->loaded)
+    {
+      cache->loaded = true;
+      scanLoadCache(band);
+    }
+  }
+
+  xSemaphoreGiveRecursive(scanMutex);
+  return(cache);
+}
+
+//
+// Find data for given frequency, either latest data for the current
+// band or from a sweep made given number of sweeps ago, or return
+// NULL if there is no such data
+//
+static const ScanPoint *scanGetPoint(uint16_t freq, uint8_t age, const ScanRange **range)
+{
+  const ScanPoint *point;
+
+  if(!age)
+  {
+    // Latest data is cached for each band
+    const ScanCache *cache = scanGetCache(bandIdx);
+    if(!cache || !cache->data || (freq<cache->start)) return(0);
+
+    uint16_t idx = (freq - cache->start) / cache->step;
+    if(idx>=cache->points) return(0);
+
+    point  = &cache->data[idx];
+    *range = &cache->range;
+  }
+  else
+  {
+    // Must have data, including the requested sweep
+    if((scanStatus==SCAN_OFF) || (age>=scanSweepCount) || (freq<scanStartFreq)) return(0);
+
+    uint16_t idx = (freq - scanStartFreq) / scanStep;
+    if(idx>=scanPoints) return(0);
+
+    uint8_t sweep = (scanSweep + scanHistory - age) % scanHistory;
+    point  = &scanData[sweep * scanPoints + idx];
+    *range = &scanSweeps[sweep].range;
+  }
+
+  return(point->snr!=SCAN_NONE? point : 0);
+}
+
+float scanGetRSSI(uint16_t freq, uint8_t age)
+{
+  const ScanRange *range;
+  const ScanPoint *point = scanGetPoint(freq, age, &range);
+  if(!point) return(0.0);
+
+  return((point->rssi - range->minRSSI) / (float)(range->maxRSSI - range->minRSSI + 1));
+}
+
+float scanGetSNR(uint16_t freq, uint8_t age)
+{
+  const ScanRange *range;
+  const ScanPoint *point = scanGetPoint(freq, age, &range);
+  if(!point) return(0.0);
+
+  return((point->snr - range->minSNR) / (float)(range->maxSNR - range->minSNR + 1));
+}
+
+float scanGetMaxRSSI(uint16_t freq)
 {
   // Input frequency must be in range of existing data
-  if((scanStatus!=SCAN_DONE) || (freq<scanStartFreq) || (freq>=scanStartFreq+scanStep*scanCount))
-    return(0.0);
+  if((scanStatus==SCAN_OFF) || (freq<scanStartFreq)) return(0.0);
 
-  uint8_t result = scanData[(freq - scanStartFreq) / scanStep].snr;
-  return((result - scanMinSNR) / (float)(scanMaxSNR - scanMinSNR + 1));
+  uint16_t idx = (freq - scanStartFreq) / scanStep;
+  if((idx>=scanPoints) || (scanMaxHold[idx]<scanHoldMin)) return(0.0);
+
+  return((scanMaxHold[idx] - scanHoldMin) / (float)(scanHoldMax - scanHoldMin + 1));
 }
 
-static void scanInit(uint16_t centerFreq, uint16_t step)
+//
+// Format next CSV line of the exported data into state->text,
+// returning FALSE when done or if the data has been reallocated
+// since the export started
+//
+static bool scanExportLine(ScanExport *state)
 {
-  scanStep    = step;
-  scanCount   = 0;
-  scanMinRSSI = 255;
-  scanMaxRSSI = 0;
-  scanMinSNR  = 255;
-  scanMaxSNR  = 0;
-  scanStatus  = SCAN_RUN;
-  scanTime    = millis();
+  const ScanCache *cache = &scanCache[state->band];
+  bool result = false;
+
+  xSemaphoreTakeRecursive(scanMutex, portMAX_DELAY);
+
+  if(cache->data && (cache->start==state->start) && (cache->step==state->step) && (cache->points==state->points) && (state->line<=cache->points))
+  {
+    int j = state->line - 1;
+    const ScanPoint *point = j<0? 0 : &cache->data[j];
 
-  const Band *band = getCurrentBand();
-  int freq = scanStep * (centerFreq / scanStep - SCAN_POINTS / 2);
+    if(!point)
+      snprintf(state->text, sizeof(state->text), "%s,%u,%u,%u\r\n", bands[state->band].bandName, cache->start, cache->step, cache->points);
+    else if(point->snr==SCAN_NONE)
+      strcpy(state->text, ",,\r\n");
+    else if(!cache->stamps[j])
+      snprintf(state->text, sizeof(state->text), "%u,%u,\r\n", point->rssi, point->snr);
+    else
+      snprintf(state->text, sizeof(state->text), "%u,%u,%lu\r\n", point->rssi, point->snr, (state->now - cache->stamps[j]) / 1000);
 
-  // Adjust to band boundaries
-  if(freq + scanStep * (SCAN_POINTS - 1) > band->maximumFreq)
-    freq = band->maximumFreq - scanStep * (SCAN_POINTS - 1);
-  if(freq < band->minimumFreq)
-    freq = band->minimumFreq;
-  scanStartFreq = freq;
+    state->line++;
+    state->pos = 0;
+    state->len = strlen(state->text);
+    result = true;
+  }
 
-  // Clear scan data
-  memset(scanData, 0, sizeof(scanData));
+  xSemaphoreGiveRecursive(scanMutex);
+  return(result);
 }
 
-static bool scanTickTime()
+//
+// Start exporting latest data for the current band as CSV: a header
+// line with band name, start frequency, step, and number of points,
+// followed by RSSI, SNR, and age (secs) of each point, with empty
+// fields for unknown values. Returns FALSE if there is no data.
+//
+bool scanExportStart(ScanExport *state)
 {
-  // Scan must be on
-  if((scanStatus!=SCAN_RUN) || (scanCount>=SCAN_POINTS)) return(false);
+  int band = bandIdx;
+  bool result = false;
+
+  xSemaphoreTakeRecursive(scanMutex, portMAX_DELAY);
 
-  // Wait for the right time
-  if(millis() - scanTime < SCAN_TIME) return(true);
+  const ScanCache *cache = scanGetCache(band);
+  if(cache && cache->data)
+  {
+    state->band   = band;
+    state->start  = cache->start;
+    state->step   = cache->step;
+    state->points = cache->points;
+    state->now    = millis();
+    state->line   = 0;
+    state->pos    = state->len = 0;
+    result = true;
+  }
 
-  // This is our current frequency to scan
-  uint16_t freq = scanStartFreq + scanStep * scanCount;
+  xSemaphoreGiveRecursive(scanMutex);
+  return(result);
+}
 
-  // If frequency not yet set, set it and wait until next call to measure
-  if(rx.getFrequency() != freq)
+//
+// Read up to size bytes of exported CSV data, returning 0 when done.
+// Safe to call from other tasks, e.g. the web server.
+//
+size_t scanExportRead(ScanExport *state, uint8_t *buf, size_t size)
+{
+  size_t done = 0;
+
+  while(done < size)
   {
-    rx.setFrequency(freq);
-    scanTime = millis();
-    return(true);
+    if((state->pos>=state->len) && !scanExportLine(state)) break;
+
+    size_t len = state->len - state->pos;
+    len = len < size - done? len : size - done;
+    memcpy(buf + done, state->text + state->pos, len);
+    state->pos += len;
+    done += len;
   }
 
-  // Measure RSSI/SNR values
-  rx.getCurrentReceivedSignalQuality();
-  scanData[scanCount].rssi = rx.getCurrentRSSI();
-  scanData[scanCount].snr  = rx.getCurrentSNR();
+  return(done);
+}
 
-  // Measure range of values
-  scanMinRSSI = min(scanData[scanCount].rssi, scanMinRSSI);
-  scanMaxRSSI = max(scanData[scanCount].rssi, scanMaxRSSI);
-  scanMinSNR  = min(scanData[scanCount].snr, scanMinSNR);
-  scanMaxSNR  = max(scanData[scanCount].snr, scanMaxSNR);
+//
+// Print latest data for the current band as CSV, see above.
+// Returns FALSE if there is no data.
+//
+bool scanPrint(Print &out)
+{
+  ScanExport state;
+  uint8_t buf[64];
+  size_t len;
 
-  // Next frequency to scan
-  freq += scanStep;
+  if(!scanExportStart(&state)) return(false);
+
+  while((len = scanExportRead(&state, buf, sizeof(buf))))
+    out.write(buf, len);
+
+  return(true);
+}
+
+static int scanCompareStations(const void *a, const void *b)
+{
+  const ScanStation *sa = (const ScanStation *)a;
+  const ScanStation *sb = (const ScanStation *)b;
 
-  // Set next frequency to scan or expire scan
-  if((++scanCount >= SCAN_POINTS) || !isFreqInBand(getCurrentBand(), freq))
-    scanStatus = SCAN_DONE;
+  return(sa->rssi!=sb->rssi? sb->rssi - sa->rssi : sb->snr - sa->snr);
+}
+
+//
+// Estimate noise floor as the median RSSI of measured points
+//
+static int scanNoiseFloor(const ScanPoint *data)
+{
+  uint16_t histogram[256];
+  int j, count, noise;
+
+  memset(histogram, 0, sizeof(histogram));
+  for(j=count=0 ; j<scanPoints ; j++)
+    if(data[j].snr!=SCAN_NONE) { histogram[data[j].rssi]++; count++; }
+
+  for(noise=0, j=0 ; (noise<255) && (j + histogram[noise] <= count / 2) ; j+=histogram[noise++]);
+  return(noise);
+}
+
+static inline bool scanIsActive(const ScanPoint *point, int minRSSI, int minSNR)
+{
+  return((point->snr!=SCAN_NONE) && (point->rssi>=minRSSI) && (point->snr>=minSNR));
+}
+
+//
+// Add station to the list. When the list is full, replace the
+// weakest station.
+//
+static void scanAddStation(const ScanStation *station)
+{
+  if(scanStationCount<SCAN_STATIONS)
+    scanStations[scanStationCount++] = *station;
   else
-    rx.setFrequency(freq);
+  {
+    int weakest = 0;
+    for(int k=1 ; k<scanStationCount ; k++)
+      if(scanCompareStations(&scanStations[k], &scanStations[weakest]) > 0) weakest = k;
+    if(scanCompareStations(station, &scanStations[weakest]) < 0)
+      scanStations[weakest] = *station;
+  }
+}
 
-  // Save last scan time
+//
+// Find stations in the latest sweep: merge adjacent points above the
+// band type thresholds and keep the strongest point of each group
+//
+static void scanFindStations()
+{
+  const ScanPoint *data = &scanData[scanSweep * scanPoints];
+  int j;
+
+  scanStationCount = 0;
+  if(!scanSweeps[scanSweep].count) return;
+
+  uint8_t type = scanBand->bandType<ITEM_COUNT(scanThresholds)? scanBand->bandType : SW_BAND_TYPE;
+  int minRSSI  = scanNoiseFloor(data) + scanThresholds[type].rssi;
+  int minSNR   = scanThresholds[type].snr;
+
+  for(j=0 ; j<scanPoints ; )
+  {
+    // Skip inactive points
+    if(!scanIsActive(&data[j], minRSSI, minSNR)) { j++; continue; }
+
+    // Find the strongest point among adjacent active points
+    int peak = j;
+    for(j++ ; (j<scanPoints) && scanIsActive(&data[j], minRSSI, minSNR) ; j++)
+      if((data[j].rssi>data[peak].rssi) || ((data[j].rssi==data[peak].rssi) && (data[j].snr>data[peak].snr)))
+        peak = j;
+
+    ScanStation station = { (uint16_t)(scanStartFreq + scanStep * peak), data[peak].rssi, data[peak].snr };
+    scanAddStation(&station);
+  }
+
+  // Rank stations
+  qsort(scanStations, scanStationCount, sizeof(ScanStation), scanCompareStations);
+}
+
+//
+// Return number of stations found by the last scan of the current band
+//
+int scanGetStations()
+{
+  return(scanBand==getCurrentBand()? scanStationCount : 0);
+}
+
+//
+// Return frequency of the next or previous station in the ranked
+// list, starting with the strongest one, or 0 if there are none
+//
+uint16_t scanStepStation(uint16_t freq, int8_t dir)
+{
+  int count = scanGetStations();
+  int j;
+
+  if(!count || !dir) return(0);
+
+  for(j=0 ; (j<count) && (scanStations[j].freq!=freq) ; j++);
+
+  // Wrap around the list, starting at either end
+  j = j>=count? (dir>0? 0 : count - 1) : (j + (dir>0? 1 : -1) + count) % count;
+  return(scanStations[j].freq);
+}
+
+static void scanFree()
+{
+  free(scanData);
+  free(scanMaxHold);
+  free(scanPending);
+  scanData    = 0;
+  scanMaxHold = 0;
+  scanPending = 0;
+  scanHistory = 0;
+  scanStatus  = SCAN_OFF;
+}
+
+//
+// Allocate sweep history for the whole band, keeping existing
+// history if the scan range has not changed
+//
+static bool scanInit(const Band *band, uint16_t step, uint16_t coarse)
+{
+  // Align scan points to the step, the same way tuning does (FM
+  // 200kHz steps are on odd 100kHz, as in 88.1, 88.3, ...)
+  uint16_t offset = (currentMode==FM) && (step==20)? 10 : 0;
+  uint16_t start  = (band->minimumFreq - offset + step - 1) / step * step + offset;
+  uint16_t points = (band->maximumFreq - start) / step + 1;
+
+  // Scan data is also cached for each band
+  xSemaphoreTakeRecursive(scanMutex, portMAX_DELAY);
+  scanCacheNow = scanGetCache(band - bands);
+  bool cached = scanCacheNow && scanInitCache(scanCacheNow, start, step, points);
+  xSemaphoreGiveRecursive(scanMutex);
+  if(!cached) return(false);
+
+  if(!scanData || (scanStartFreq!=start) || (scanStep!=step) || (scanPoints!=points))
+  {
+    scanFree();
+
+    // Fall back to a single sweep if there is not enough memory
+    for(scanHistory=SCAN_HISTORY ; scanHistory ; scanHistory=scanHistory>1? 1:0)
+      if((scanData = (ScanPoint *)scanAlloc(scanHistory * points * sizeof(ScanPoint))))
+        break;
+
+    scanMaxHold = (uint8_t *)scanAlloc(points);
+    scanPending = (uint8_t *)scanAlloc((points + 7) / 8);
+    if(!scanData || !scanMaxHold || !scanPending)
+    {
+      scanFree();
+      return(false);
+    }
+
+    scanStartFreq  = start;
+    scanStep       = step;
+    scanPoints     = points;
+    scanSweep      = scanHistory - 1;
+    scanSweepCount = 0;
+    scanHoldMin    = 255;
+    scanHoldMax    = 0;
+    memset(scanMaxHold, 0, points);
+  }
+
+  // Start a new sweep, overwriting the oldest one
+  scanSweep = (scanSweep + 1) % scanHistory;
+  scanSweepCount = min(scanSweepCount + 1, scanHistory);
+  scanSweeps[scanSweep].count = 0;
+  scanSweeps[scanSweep].range = { 255, 0, 255, 0 };
+  memset(&scanData[scanSweep * scanPoints], SCAN_NONE, scanPoints * sizeof(ScanPoint));
+  memset(scanPending, 0, (scanPoints + 7) / 8);
+
+  scanIndex  = 0;
+  scanPass   = 0;
+  scanCoarse = coarse;
+  scanMapping = false;
+  scanStatus = SCAN_RUN;
+  scanTime   = millis();
+  scanBand   = band;
+  scanStationCount = 0;
+
+  // Clear statistics
+  memset(&scanStats, 0, sizeof(scanStats));
+  scanSweepTime = scanTime;
+  return(true);
+}
+
+//
+// Stop scan, keeping data collected so far, and return to the
+// user frequency without waiting for the radio
+//
+void scanStop()
+{
+  if(scanStatus!=SCAN_RUN) return;
+
+  scanStatus = SCAN_DONE;
+  scanStats.sweepTime = millis() - scanSweepTime;
+
+  if(scanMapping)
+  {
+    // Cancel seek in progress, rank stations found by seek
+    rx.getStatus(1, 1);
+    if(scanMapPeak.freq) scanAddStation(&scanMapPeak);
+    qsort(scanStations, scanStationCount, sizeof(ScanStation), scanCompareStations);
+  }
+  else
+  {
+    // Find stations in whatever has been scanned
+    scanFindStations();
+  }
+
+  radioTune(scanUserFreq);
+}
+
+//
+// Tune to the next scan point without waiting for the radio
+//
+static void scanTune(uint16_t freq)
+{
+  // Apply pending tuning, then clear stale tune completion status
+  radioSync();
+  rx.getStatus(1, 0);
+  rx.setFrequencyNoWait(freq);
   scanTime = millis();
+}
 
-  // Return current scan status
-  return(scanStatus==SCAN_RUN);
+//
+// Mark fine points around coarse points above the noise floor to
+// be revisited
+//
+static void scanMarkNeighbours()
+{
+  const ScanPoint *data = &scanData[scanSweep * scanPoints];
+  int minRSSI = scanNoiseFloor(data) + SCAN_COARSE_MARGIN;
+
+  for(int j=0 ; j<scanPoints ; j+=scanCoarse)
+    if(data[j].rssi>=minRSSI)
+      for(int k=j>=scanCoarse? j-scanCoarse+1 : 0 ; (k<j+scanCoarse) && (k<scanPoints) ; k++)
+        if(data[k].snr==SCAN_NONE) scanPending[k>>3] |= 1 << (k & 7);
+}
+
+//
+// Advance to the next point to measure, return FALSE when done
+//
+static bool scanNextPoint()
+{
+  if(!scanPass)
+  {
+    // Coarse pass, or the only pass
+    scanIndex += scanCoarse;
+    if(scanIndex<scanPoints) return(true);
+    if(scanCoarse<=1) return(false);
+
+    // Switch to the fine pass
+    scanMarkNeighbours();
+    scanPass  = 1;
+    scanIndex = -1;
+  }
+
+  // Fine pass visits marked points only
+  for(scanIndex++ ; scanIndex<scanPoints ; scanIndex++)
+    if(scanPending[scanIndex>>3] & (1 << (scanIndex & 7))) return(true);
+
+  return(false);
+}
+
+//
+// Measure the point being refreshed once tuning completes, then
+// return to the user frequency without waiting for the radio
+//
+static bool scanRefreshTick()
+{
+  ScanCache *cache = scanGetCache(scanRefreshBand);
+  int point = scanRefreshPoint;
+
+  // Give up if the user has retuned or changed band meanwhile, they
+  // have left the refresh frequency already
+  if((scanRefreshBand!=bandIdx) || (currentFrequency!=scanRefreshUser) || !cache || !cache->data)
+  {
+    scanRefreshPoint = -1;
+    return(false);
+  }
+
+  // Measure as soon as tuning completes, but wait no longer than
+  // the upper bound for the current mode
+  uint32_t dwell = millis() - scanTime;
+  uint32_t maxDwell = currentMode==FM? SCAN_TIME_FM : isSSB()? SCAN_TIME_SSB : SCAN_TIME_AM;
+  if(dwell < maxDwell)
+  {
+    rx.getStatus(0, 0);
+    if(!rx.getTuneCompleteTriggered()) return(false);
+  }
+
+  RadioSample sample = radioMeasure();
+  ScanPoint data = { sample.rssi, sample.snr };
+  scanRefreshPoint = -1;
+  radioTune(scanRefreshUser);
+
+  cache->data[point]   = data;
+  cache->stamps[point] = millis() | 1;
+  cache->dirty         = true;
+  scanUpdateRange(&cache->range, &data);
+  return(true);
+}
+
+//
+// Start measuring the stalest cached point of the current band,
+// finished by scanRefreshTick() on later ticks
+//
+static void scanRefresh()
+{
+  ScanCache *cache = scanGetCache(bandIdx);
+  uint32_t now = millis();
+  int j, stalest;
+
+  // Must have data, refresh at a limited rate
+  if(!cache || !cache->data || (now - scanRefreshTime < SCAN_REFRESH_TIME)) return;
+  scanRefreshTime = now;
+
+  // Points never measured are the stalest
+  for(j=stalest=0 ; (j<cache->points) && cache->stamps[stalest] ; j++)
+    if(!cache->stamps[j] || ((int32_t)(cache->stamps[j] - cache->stamps[stalest]) < 0))
+      stalest = j;
+
+  if(cache->stamps[stalest] && (now - cache->stamps[stalest] < SCAN_STALE_TIME))
+    return;
+
+  scanRefreshPoint = stalest;
+  scanRefreshBand  = bandIdx;
+  scanRefreshUser  = currentFrequency;
+  scanTune(cache->start + cache->step * stalest);
+}
+
+//
+// Store values measured at the current scan point
+//
+static void scanRecord(uint8_t rssi, uint8_t snr)
+{
+  ScanPoint *point = &scanData[scanSweep * scanPoints + scanIndex];
+  point->rssi = rssi;
+  point->snr  = snr;
+
+  // Measure range of values
+  scanUpdateRange(&scanSweeps[scanSweep].range, point);
+  scanSweeps[scanSweep].count++;
+
+  // Update band cache
+  scanCacheNow->data[scanIndex]   = *point;
+  scanCacheNow->stamps[scanIndex] = millis() | 1;
+  scanCacheNow->dirty             = true;
+  scanUpdateRange(&scanCacheNow->range, point);
+
+  // Update max hold
+  scanMaxHold[scanIndex] = max(point->rssi, scanMaxHold[scanIndex]);
+  scanHoldMin = min(point->rssi, scanHoldMin);
+  scanHoldMax = max(point->rssi, scanHoldMax);
+}
+
+//
+// Record where tuning or seeking has stopped and seek further up,
+// finishing at the band edge. Seek validates stations with the radio's
+// own RSSI/SNR thresholds, so every valid stop is a station.
+//
+static bool scanMapTick()
+{
+  uint32_t dwell = millis() - scanTime;
+
+  rx.getStatus(0, 0);
+  if(!rx.getTuneCompleteTriggered())
+  {
+    if(dwell < SCAN_TIME_SEEK) return(false);
+
+    // Seek got stuck, give up
+    scanStats.timeouts++;
+    scanStop();
+    return(true);
+  }
+
+  // Update statistics
+  uint16_t freq = rx.getStatusFrequency();
+  scanStats.points++;
+  scanStats.dwellTime += dwell;
+  scanStats.maxDwell = dwell > scanStats.maxDwell? dwell : scanStats.maxDwell;
+
+  // Tune status includes RSSI/SNR at the stop
+  uint8_t rssi = rx.getReceivedSignalStrengthIndicator();
+  uint8_t snr  = rx.getStatusSNR();
+
+  if((freq>=scanStartFreq) && ((freq - scanStartFreq) % scanStep == 0) && ((freq - scanStartFreq) / scanStep < scanPoints))
+  {
+    scanIndex = (freq - scanStartFreq) / scanStep;
+    scanRecord(rssi, snr);
+  }
+
+  if(rx.getStatusValid())
+  {
+    ScanStation station = { freq, rssi, snr };
+
+    // Seek also stops next to strong stations, adjacent stops belong
+    // to the same station, keep the strongest one
+    if(scanMapPeak.freq && (freq - scanMapLast == scanStep))
+    {
+      if(scanCompareStations(&station, &scanMapPeak) < 0) scanMapPeak = station;
+    }
+    else
+    {
+      if(scanMapPeak.freq) scanAddStation(&scanMapPeak);
+      scanMapPeak = station;
+    }
+
+    scanMapLast = freq;
+  }
+
+  // Done when seek reaches the band edge
+  if(rx.getBandLimit() || (freq + scanStep > scanBand->maximumFreq))
+  {
+    scanStop();
+  }
+  else
+  {
+    rx.getStatus(1, 0);
+    rx.seekStation(1, 0);
+    scanTime = millis();
+  }
+
+  return(true);
 }
 
 //
-// Run entire scan once
+// Measure next scan point, if it is time to do so. When not scanning,
+// save changed data, finish refreshing a cached point, or start
+// refreshing stale cached data if refresh is TRUE. Returns TRUE when
+// new data has been collected and the scale needs redrawing.
 //
-void scanRun(uint16_t centerFreq, uint16_t step)
+bool scanTickTime(bool refresh)
 {
-  // Save current frequency
-  uint16_t curFreq = rx.getFrequency();
-  // Scan the whole range
-  for(scanInit(centerFreq, step) ; scanTickTime() ; delay(SCAN_TIME));
-  // Restore current frequency
-  rx.setFrequency(curFreq);
+  // Save and refresh cached data when not scanning
+  if(scanStatus!=SCAN_RUN)
+  {
+    scanSaveTick();
+    if(scanRefreshPoint>=0) return(scanRefreshTick());
+    if(refresh) scanRefresh();
+    return(false);
+  }
+
+  // Mapping band with seek
+  if(scanMapping) return(scanMapTick());
+
+  // Measure as soon as tuning completes, but wait no longer than
+  // the upper bound for the current mode, halved on the coarse pass
+  uint32_t dwell = millis() - scanTime;
+  uint32_t maxDwell = currentMode==FM? SCAN_TIME_FM : isSSB()? SCAN_TIME_SSB : SCAN_TIME_AM;
+  if((scanCoarse>1) && !scanPass) maxDwell /= 2;
+  if(dwell < maxDwell)
+  {
+    rx.getStatus(0, 0);
+    if(!rx.getTuneCompleteTriggered()) return(false);
+  }
+  else
+  {
+    scanStats.timeouts++;
+  }
+
+  // Update statistics
+  scanStats.points++;
+  scanStats.dwellTime += dwell;
+  scanStats.maxDwell = dwell > scanStats.maxDwell? dwell : scanStats.maxDwell;
+
+  // Measure RSSI/SNR values
+  RadioSample sample = radioMeasure();
+  scanRecord(sample.rssi, sample.snr);
+
+  // Set next frequency to scan or finish scan
+  if(!scanNextPoint())
+    scanStop();
+  else
+    scanTune(scanStartFreq + scanStep * scanIndex);
+
+  // New data available
+  return(true);
+}
+
+//
+// Start scanning the whole current band with given step, optionally
+// in two passes. The scan is then run from the main loop by
+// scanTickTime().
+//
+bool scanStart(uint16_t step, bool twoPass)
+{
+  uint16_t coarse = (currentMode==FM? SCAN_COARSE_FM : SCAN_COARSE_AM) / step;
+
+  // Stop any scan in progress
+  scanStop();
+
+  // Save current frequency, scan replaces refresh in progress
+  scanUserFreq = currentFrequency;
+  scanRefreshPoint = -1;
+
+  // Start with the first scan point
+  if(!scanInit(getCurrentBand(), step, twoPass && (coarse>1)? coarse : 1)) return(false);
+  scanTune(scanStartFreq);
+  return(true);
+}
+
+//
+// Start mapping the current band with the radio's seek, from the band
+// minimum up to the band edge. Seek does not work in SSB modes.
+//
+bool scanMap(uint16_t step)
+{
+  // Stop any scan in progress
+  scanStop();
+
+  if(isSSB()) return(false);
+
+  // Save current frequency, scan replaces refresh in progress
+  scanUserFreq = currentFrequency;
+  scanRefreshPoint = -1;
+
+  // Check the band minimum first, then seek up from there
+  if(!scanInit(getCurrentBand(), step, 1)) return(false);
+  scanMapping = true;
+  scanMapPeak.freq = 0;
+  scanTune(scanStartFreq);
+  return(true);
 }
@@ -8,10 +8,24 @@
 #define MIN_CB_FREQUENCY 26060
 #define MAX_CB_FREQUENCY 29665
 
+// CB channel layout: columns A-H, 45 channels per column
+#define CB_COLUMN_STEP   450 // In kHz
+#define CB_ROW_STEP      10
+#define CB_COLUMNS       8
+#define CB_ROWS          45
+
+// Frequency annotation layers, in order of decreasing priority
+#define LAYER_NAMED      0   // Named frequencies
+#define LAYER_CB         1   // CB channels
+#define LAYER_BAND       2   // Band labels
+
+// Number of cached schedule lookups
+#define FREQ_CACHE_SIZE  32
+
 //
 // Named frequencies, sorted by increasing frequency!
 //
-static const NamedFreq namedFrequencies[] =
+static constexpr NamedFreq namedFrequencies[] =
 {
   {  1840, "FT8"  }, {  3573, "FT8"  }, {  5357, "FT8"  }, {  7074, "FT8" },
   {  7165, "SSTV" }, {  7171, "SSTV" }, { 10136, "FT8"  }, { 14074, "FT8" },
@@ -19,10 +33,61 @@ static const NamedFreq namedFrequencies[] =
   { 27700, "SSTV" }, { 28074, "FT8"  }, { 28680, "SSTV" },
 };
 
+//
+// Band labels, sorted by increasing starting frequency! Labels may
+// overlap, in which case the narrowest one wins.
+//
+static constexpr BandLabel bandLabels[] =
+{
+  {   472,   479, "630m (CW)"      },
+  {   500,   518, "NAVTEX"         },
+  {   525,  1705, "MW Broadcast"   },
+  {  1600,  1800, "Top Band"       },
+  {  2300,  2495, "120m BC"        },
+  {  3200,  3400, "90m BC"         },
+  {  3500,  3800, "80m (Amateur)"  },
+  {  3700,  3800, "80m (SSB)"      },
+  {  3900,  4000, "75m BC"         },
+  {  4720,  4750, "60m (Amateur)"  },
+  {  4750,  4995, "60m BC"         },
+  {  5900,  6200, "49m BC"         },
+  {  7000,  7040, "40m (CW)"       },
+  {  7040,  7100, "40m (DIGI)"     },
+  {  7100,  7200, "40m (SSB)"      },
+  {  7200,  7600, "41m BC"         },
+  {  9400,  9900, "31m BC"         },
+  { 10100, 10140, "30m (CW)"       },
+  { 10136, 10140, "30m (FT8)"      },
+  { 10140, 10150, "30m (DIGI)"     },
+  { 11600, 12100, "25m BC"         },
+  { 14000, 14070, "20m (CW)"       },
+  { 14070, 14100, "20m (DIGI/FT8)" },
+  { 14100, 14350, "20m (SSB)"      },
+  { 15100, 15800, "19m BC"         },
+  { 17480, 17900, "16m BC"         },
+  { 18068, 18110, "17m (CW)"       },
+  { 18100, 18110, "17m (FT8)"      },
+  { 18110, 18168, "17m (SSB)"      },
+  { 21000, 21070, "15m (CW)"       },
+  { 21070, 21100, "15m (DIGI/FT8)" },
+  { 21100, 21450, "15m (SSB)"      },
+  { 21450, 21850, "13m BC"         },
+  { 24890, 24915, "12m (CW)"       },
+  { 24915, 24925, "12m (FT8)"      },
+  { 24925, 24990, "12m (SSB)"      },
+  { 25670, 26100, "11m BC"         },
+  { 26100, 26500, "11m BC"         },
+  { 26960, 27410, "11m (CB)"       },
+  { 28000, 28120, "10m (CW)"       },
+  { 28120, 28190, "10m (DIGI/FT8)" },
+  { 28200, 29700, "10m (SSB/FM)"   },
+  { 29600, 30000, "9m BC"          },
+};
+
 //
 // CB channel mappings
 //
-static const char *cbChannelNumber[] =
+static constexpr const char *cbChannelNumber[] =
 {
   "1",  "2",  "3",  "41",
   "4",  "5",  "6",  "7",  "42",
@@ -37,6 +102,59 @@ static const char *cbChannelNumber[] =
   "40",
 };
 
+//
+// Check static tables at compile time
+//
+template<size_t N> static constexpr bool isSorted(const NamedFreq (&db)[N])
+{
+  for(size_t j=1 ; j<N ; j++)
+    if(db[j-1].freq>=db[j].freq) return(false);
+  return(true);
+}
+
+template<size_t N> static constexpr bool isSorted(const BandLabel (&db)[N])
+{
+  for(size_t j=0 ; j<N ; j++)
+    if((db[j].freq_start>=db[j].freq_end) || (j && (db[j-1].freq_start>db[j].freq_start)))
+      return(false);
+  return(true);
+}
+
+static_assert(isSorted(namedFrequencies), "namedFrequencies[] must be sorted by frequency");
+static_assert(isSorted(bandLabels), "bandLabels[] must be sorted by starting frequency");
+static_assert(ITEM_COUNT(cbChannelNumber)==CB_ROWS, "cbChannelNumber[] must have CB_ROWS entries");
+static_assert((CB_ROWS-1) * CB_ROW_STEP + 5 < CB_COLUMN_STEP, "CB columns must not overlap");
+static_assert(MIN_CB_FREQUENCY + (CB_COLUMNS-1) * CB_COLUMN_STEP + (CB_ROWS-1) * CB_ROW_STEP + 5 <= MAX_CB_FREQUENCY, "CB channels must fit CB range");
+
+//
+// All static annotations as a sorted list of non-overlapping
+// frequency intervals, built on first use
+//
+typedef struct
+{
+  uint16_t start;         // First frequency
+  uint16_t end;           // Last frequency (inclusive)
+  uint8_t  layer;         // LAYER_*
+  const char *name;       // Annotation text
+} FreqAnnotation;
+
+#define CB_CHANNELS (CB_COLUMNS * CB_ROWS * 2)
+
+static FreqAnnotation *annotations = 0;
+static int annotationCount = 0;
+static char (*cbChannelNames)[6] = 0;
+
+//
+// Recent schedule lookups, indexed by frequency
+//
+static struct
+{
+  uint16_t freq;          // Frequency (0 = empty)
+  uint16_t time;          // Lookup time (hour * 60 + minute)
+  size_t   offset;        // Schedule entry offset
+  char     name[32];      // Station name ("" = none)
+} freqCache[FREQ_CACHE_SIZE];
+
 //
 // RDS program types
 //
@@ -243,50 +361,147 @@ bool checkRds()
   return(needRedraw);
 }
 
-static const char *findCBChannelByFreq(uint16_t freq)
+static void *annotationAlloc(size_t size)
+{
+  return(psramFound()? ps_malloc(size) : malloc(size));
+}
+
+static void addAnnotation(uint16_t start, uint16_t end, uint8_t layer, const char *name)
+{
+  FreqAnnotation *last = annotationCount? &annotations[annotationCount-1] : 0;
+
+  // Extend previous interval if it carries the same annotation
+  if(last && (last->layer==layer) && (last->name==name) && (last->end+1==start))
+    last->end = end;
+  else
+    annotations[annotationCount++] = { start, end, layer, name };
+}
+
+static const BandLabel *findBandLabel(uint16_t freq)
+{
+  const BandLabel *result = 0;
+
+  // Find the narrowest label covering given frequency
+  for(int j=0 ; (j<ITEM_COUNT(bandLabels)) && (bandLabels[j].freq_start<=freq) ; j++)
+    if((freq<bandLabels[j].freq_end) && (!result ||
+       (bandLabels[j].freq_end - bandLabels[j].freq_start < result->freq_end - result->freq_start)))
+      result = &bandLabels[j];
+
+  return(result);
+}
+
+static bool buildAnnotations()
 {
-  const int column_step = 450; // In kHz
-  const int row_step    = 10;
-  const int max_columns = 8;   // A-H
-  const int max_rows    = 45;
-  static char buf[50];
+  const int maxCount = 2 * (ITEM_COUNT(bandLabels) + ITEM_COUNT(namedFrequencies) + CB_CHANNELS) + 1;
+  uint16_t cbFreqs[CB_CHANNELS];
+  int j, named, cb;
+
+  // Only build once
+  if(annotations) return(true);
+
+  annotations    = (FreqAnnotation *)annotationAlloc(maxCount * sizeof(FreqAnnotation));
+  cbChannelNames = (char (*)[6])annotationAlloc(CB_CHANNELS * sizeof(*cbChannelNames));
 
-  if(freq<MIN_CB_FREQUENCY || freq>MAX_CB_FREQUENCY) return(0);
+  if(!annotations || !cbChannelNames)
+  {
+    free(annotations);
+    free(cbChannelNames);
+    annotations    = 0;
+    cbChannelNames = 0;
+    return(false);
+  }
 
-  int offset = freq - MIN_CB_FREQUENCY;
-  char type  = 'R';
-  if((offset%10) == 5)
+  // Generate CB channel names, in order of increasing frequency
+  for(j=0 ; j<CB_CHANNELS ; j++)
   {
-    type = 'E';
-    offset -= 5;
+    int column = j / (CB_ROWS * 2);
+    int row    = (j / 2) % CB_ROWS;
+    char *p    = cbChannelNames[j];
+
+    *p++ = 'A' + column;
+    for(const char *n = cbChannelNumber[row] ; *n ; ) *p++ = *n++;
+    *p++ = j & 1? 'E' : 'R';
+    *p   = '\0';
+
+    cbFreqs[j] = MIN_CB_FREQUENCY + column * CB_COLUMN_STEP + row * CB_ROW_STEP + (j & 1) * 5;
   }
 
-  int column_index = offset / column_step;
-  int remainder    = offset % column_step;
-  if((column_index>=max_columns) || (remainder%row_step)) return(0);
+  // Punch named frequencies and CB channels into band labels
+  annotationCount = 0;
+  for(uint32_t freq=0, next ; freq<=0xFFFF ; freq=next)
+  {
+    for(named=0 ; (named<ITEM_COUNT(namedFrequencies)) && (namedFrequencies[named].freq<freq) ; named++);
+    for(cb=0 ; (cb<CB_CHANNELS) && (cbFreqs[cb]<freq) ; cb++);
+
+    // Named frequencies take priority over CB channels
+    if((named<ITEM_COUNT(namedFrequencies)) && (namedFrequencies[named].freq==freq))
+    {
+      addAnnotation(freq, freq, LAYER_NAMED, namedFrequencies[named].name);
+      next = freq + 1;
+      continue;
+    }
+
+    if((cb<CB_CHANNELS) && (cbFreqs[cb]==freq))
+    {
+      addAnnotation(freq, freq, LAYER_CB, cbChannelNames[cb]);
+      next = freq + 1;
+      continue;
+    }
+
+    // Find next point where annotations may change
+    next = 0x10000;
+    if(named<ITEM_COUNT(namedFrequencies)) next = min(next, (uint32_t)namedFrequencies[named].freq);
+    if(cb<CB_CHANNELS) next = min(next, (uint32_t)cbFreqs[cb]);
+    for(j=0 ; j<ITEM_COUNT(bandLabels) ; j++)
+    {
+      if(bandLabels[j].freq_start>freq) next = min(next, (uint32_t)bandLabels[j].freq_start);
+      if(bandLabels[j].freq_end>freq)   next = min(next, (uint32_t)bandLabels[j].freq_end);
+    }
 
-  int row_number = remainder / row_step;
-  if((row_number>=max_rows) || (row_number<0)) return(0);
+    // Band label stays the same until the next point
+    const BandLabel *label = findBandLabel(freq);
+    if(label) addAnnotation(freq, next - 1, LAYER_BAND, label->name);
+  }
 
-  sprintf(buf, "%c%s%c", 'A' + column_index, cbChannelNumber[row_number], type);
-  return(buf);
+  return(true);
 }
 
-static const char *findNameByFreq(uint16_t freq, const NamedFreq *db, uint16_t dbSize)
+static const FreqAnnotation *findAnnotation(uint16_t freq)
 {
   int r, l;
 
-  for(l=0, r=dbSize-1 ; l <= r ; )
+  if(!buildAnnotations()) return(0);
+
+  for(l=0, r=annotationCount-1 ; l <= r ; )
   {
     int m = (l + r) >> 1;
-    if(db[m].freq < freq)      l = m + 1;
-    else if(db[m].freq > freq) r = m - 1;
-    else return(db[m].name);
+    if(annotations[m].end < freq)        l = m + 1;
+    else if(annotations[m].start > freq) r = m - 1;
+    else return(&annotations[m]);
   }
 
   return(0);
 }
 
+const char *getBandLabel(uint16_t freq)
+{
+  const FreqAnnotation *a = findAnnotation(freq);
+
+  // Point annotations hide band labels
+  if(a && (a->layer!=LAYER_BAND))
+  {
+    const BandLabel *label = findBandLabel(freq);
+    return(label? label->name : 0);
+  }
+
+  return(a? a->name : 0);
+}
+
+void clearFrequencyCache()
+{
+  memset(freqCache, 0, sizeof(freqCache));
+}
+
 static const char *findScheduleByFreq(uint16_t freq, bool periodic)
 {
   uint8_t hour, minute;
@@ -318,11 +533,28 @@ static const char *findScheduleByFreq(uint16_t freq, bool periodic)
   // Try new EIBI lookup if not found or once per minute
   if(!periodic || (!entry && last_offset != (size_t)-1) || last_minute != minute)
   {
+    uint16_t time = hour * 60 + minute;
+    auto *cached = &freqCache[freq % FREQ_CACHE_SIZE];
+
     last_freq = freq;
     last_minute = minute;
+
+    // Tuning back and forth hits the same frequencies, use cached results
+    if(!periodic && (cached->freq==freq) && (cached->time==time))
+    {
+      first_offset = last_offset = cached->offset;
+      return(cached->offset!=(size_t)-1? cached->name : 0);
+    }
+
     last_offset = (size_t)-1;
     entry = eibiLookup(freq, hour, minute, &last_offset);
     first_offset = last_offset = entry ? last_offset : (size_t)-1;
+
+    cached->freq   = freq;
+    cached->time   = time;
+    cached->offset = last_offset;
+    strncpy(cached->name, entry? entry->name : "", sizeof(cached->name) - 1);
+    cached->name[sizeof(cached->name) - 1] = '\0';
   }
 
   // Return just the station name
@@ -346,20 +578,12 @@ bool identifyFrequency(uint16_t freq, bool periodic)
   // For non-periodic calls the name will be found earlier
   if(!periodic)
   {
-    // Try list of named frequencies first
-    name = findNameByFreq(freq, namedFrequencies, ITEM_COUNT(namedFrequencies));
-    if(name)
-    {
-      name_found = true;
-      return(showStationName(name));
-    }
-
-    // Try CB channel names
-    name = findCBChannelByFreq(freq);
-    if(name)
+    // Try named frequencies and CB channels, band labels are not shown
+    const FreqAnnotation *a = findAnnotation(freq);
+    if(a && (a->layer<LAYER_BAND))
     {
       name_found = true;
-      return(showStationName(name));
+      return(showStationName(a->name));
     }
   }
 
@@ -0,0 +1,165 @@
+#include "Common.h"
+
+#define TIMER_MAX 16 // Maximum number of timers
+
+typedef struct
+{
+  uint32_t  deadline;     // millis() when the timer expires next
+  uint32_t  period;       // Timer period (ms)
+  TimerFunc func;         // Called when the timer expires
+} Timer;
+
+//
+// Timers are kept in a min-heap ordered by deadline, with the
+// earliest deadline at timerHeap[0]
+//
+static Timer   timers[TIMER_MAX];
+static uint8_t timerHeap[TIMER_MAX]; // Timer IDs, earliest first
+static uint8_t timerPos[TIMER_MAX];  // Heap position of each timer
+static uint8_t timerCount = 0;
+
+// Main loop task, woken up by input events
+static TaskHandle_t timerTask = 0;
+static TimerStats timerStats;
+
+static inline bool timerBefore(uint8_t a, uint8_t b)
+{
+  return((int32_t)(timers[a].deadline - timers[b].deadline) < 0);
+}
+
+static void timerSwap(int i, int j)
+{
+  uint8_t id = timerHeap[i];
+  timerHeap[i] = timerHeap[j];
+  timerHeap[j] = id;
+  timerPos[timerHeap[i]] = i;
+  timerPos[timerHeap[j]] = j;
+}
+
+static void timerSiftUp(int i)
+{
+  for( ; i && timerBefore(timerHeap[i], timerHeap[(i-1)/2]) ; i=(i-1)/2)
+    timerSwap(i, (i-1)/2);
+}
+
+static void timerSiftDown(int i)
+{
+  while(true)
+  {
+    int first = i;
+    int left  = 2*i + 1;
+    int right = left + 1;
+
+    if((left<timerCount) && timerBefore(timerHeap[left], timerHeap[first]))
+      first = left;
+    if((right<timerCount) && timerBefore(timerHeap[right], timerHeap[first]))
+      first = right;
+    if(first==i) break;
+
+    timerSwap(i, first);
+    i = first;
+  }
+}
+
+//
+// Register function to be called every given number of msecs,
+// returning timer ID or -1 if there are too many timers
+//
+int timerAdd(uint32_t period, TimerFunc func)
+{
+  if(timerCount>=TIMER_MAX) return(-1);
+
+  int id = timerCount++;
+  timers[id].deadline = millis() + period;
+  timers[id].period   = period;
+  timers[id].func     = func;
+  timerHeap[id] = id;
+  timerPos[id]  = id;
+  timerSiftUp(id);
+  return(id);
+}
+
+//
+// Restart timer, so that it expires one full period from now
+//
+void timerRestart(int id)
+{
+  if((id<0) || (id>=timerCount)) return;
+
+  timers[id].deadline = millis() + timers[id].period;
+  timerSiftUp(timerPos[id]);
+  timerSiftDown(timerPos[id]);
+}
+
+//
+// Call functions of all expired timers, return TRUE if any of
+// them requested a redraw
+//
+bool timerTickTime()
+{
+  uint32_t now = millis();
+  bool needRedraw = false;
+
+  while(timerCount && ((int32_t)(now - timers[timerHeap[0]].deadline) >= 0))
+  {
+    Timer *timer = &timers[timerHeap[0]];
+
+    // Keep the timer in phase, unless it has fallen behind
+    timer->deadline += timer->period;
+    if((int32_t)(now - timer->deadline) >= 0) timer->deadline = now + timer->period;
+    timerSiftDown(0);
+
+    needRedraw |= timer->func();
+  }
+
+  return(needRedraw);
+}
+
+//
+// Sleep until the next timer expires, an input event occurs, or
+// given number of msecs passes, whichever comes first
+//
+void timerSleep(uint32_t maxTime)
+{
+  uint32_t now = millis();
+  uint32_t wait = maxTime;
+
+  if(!timerTask) timerTask = xTaskGetCurrentTaskHandle();
+
+  if(timerCount)
+  {
+    int32_t left = timers[timerHeap[0]].deadline - now;
+    wait = left<=0? 0 : left<(int32_t)maxTime? left : maxTime;
+  }
+
+  timerStats.wakeups++;
+  if(!wait) return;
+
+  // Pending events end the sleep right away
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait));
+  timerStats.idleTime += millis() - now;
+}
+
+//
+// Wake up the main loop on an input event
+//
+void timerWake()
+{
+  if(timerTask) xTaskNotifyGive(timerTask);
+}
+
+ICACHE_RAM_ATTR void timerWakeFromISR()
+{
+  BaseType_t woken = pdFALSE;
+
+  if(timerTask)
+  {
+    vTaskNotifyGiveFromISR(timerTask, &woken);
+    if(woken) portYIELD_FROM_ISR();
+  }
+}
+
+const TimerStats *timerGetStats()
+{
+  return(&timerStats);
+}
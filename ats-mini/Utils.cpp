@@ -196,6 +196,7 @@ bool sleepOn(int x)
       rtc_gpio_pulldown_dis((gpio_num_t)ENCODER_PUSH_BUTTON);
       rtc_gpio_deinit((gpio_num_t)ENCODER_PUSH_BUTTON);
       pinMode(ENCODER_PUSH_BUTTON, INPUT_PULLUP);
+      attachInterrupt(digitalPinToInterrupt(ENCODER_PUSH_BUTTON), timerWakeFromISR, CHANGE);
       if(squelchCutoff) tempMuteOn(true);
       sleepOn(false);
       // Enable WiFi
@@ -15,7 +15,8 @@
 #include "EIBI.h"
 
 // SI473/5 and UI
-#define MIN_ELAPSED_TIME         5  // 300
+#define MIN_ELAPSED_TIME         5  // Main loop period while polling input (ms)
+#define MAX_SLEEP_TIME         100  // Longest main loop sleep, for inputs that can not wake it up (ms)
 #define MIN_ELAPSED_RSSI_TIME  200  // RSSI check uses IN_ELAPSED_RSSI_TIME * 6 = 1.2s
 #define ELAPSED_COMMAND      10000  // time to turn off the last command controlled by encoder. Time to goes back to the VFO control // G8PTN: Increased time and corrected comment
 #define DEFAULT_VOLUME          35  // change it for your favorite sound volume
@@ -27,6 +28,11 @@
 #define SCHEDULE_CHECK_TIME   2000  // How often to identify the same frequency (ms)
 #define BACKGROUND_REFRESH_TIME 5000    // Background screen refresh time. Covers the situation where there are no other events causing a refresh
 #define TUNE_HOLDOFF_TIME       90  // Timer to hold off display whilst tuning
+#define TIMEOUT_CHECK_TIME    1000  // How often to check command and display sleep timeouts (ms)
+#define TICK_TIME              100  // How often to tick background subsystems (ms)
+#define CLOCK_TICK_TIME       1000  // How often to advance the clock (ms)
+#define STATUS_PRINT_TIME      500  // How often to print status to serial when logging (ms)
+#define SCAN_IDLE_TIME       30000  // Idle time before refreshing stale scan data while silent (ms)
 
 // =================================
 // CONSTANTS AND VARIABLES
@@ -40,16 +46,7 @@ int8_t softMuteMaxAttIdx = 4;
 bool seekStop = false;        // G8PTN: Added flag to abort seeking on rotary encoder detection
 bool pushAndRotate = false;   // Push and rotate is active, ignore the long press
 
-long elapsedRSSI = millis();
-long elapsedButton = millis();
-
-long lastStrengthCheck = millis();
-long lastRDSCheck = millis();
-long lastNTPCheck = millis();
-long lastScheduleCheck = millis();
-
 long elapsedCommand = millis();
-volatile int encoderCount = 0;
 uint16_t currentFrequency;
 
 // AGC/ATTN index per mode (FM/AM/SSB)
@@ -78,7 +75,7 @@ bool zoomMenu = false;                  // Display zoomed menu item
 int8_t scrollDirection = 1;             // Menu scroll direction
 
 // Background screen refresh
-uint32_t background_timer = millis();   // Background screen refresh timer.
+int background_timer = -1;              // Background screen refresh timer.
 uint32_t tuning_timer = millis();       // Tuning hold off timer.
 bool tuning_flag = false;               // Flag to indicate tuning
 
@@ -242,6 +239,18 @@ void setup()
   attachInterrupt(digitalPinToInterrupt(ENCODER_PIN_A), rotaryEncoder, CHANGE);
   attachInterrupt(digitalPinToInterrupt(ENCODER_PIN_B), rotaryEncoder, CHANGE);
 
+  // Button presses and serial input wake up the main loop
+  attachInterrupt(digitalPinToInterrupt(ENCODER_PUSH_BUTTON), timerWakeFromISR, CHANGE);
+#if !defined(DISABLE_REMOTE) && ARDUINO_USB_MODE && ARDUINO_USB_CDC_ON_BOOT
+  Serial.onEvent(ARDUINO_HW_CDC_RX_EVENT, serialWake);
+#endif
+
+  // Periodic tasks run from the main loop
+  initTimers();
+
+  // Radio I/O runs on core 0 while the main loop draws or sleeps
+  radioInit();
+
   // Connect WiFi, if necessary
   netInit(wifiModeIdx);
 
@@ -262,16 +271,30 @@ ICACHE_RAM_ATTR void rotaryEncoder()
   uint8_t encoderStatus = encoder.process();
   if(encoderStatus)
   {
-    encoderCount = encoderStatus==DIR_CW? 1 : -1;
+    encoderPushFromISR(encoderStatus==DIR_CW? 1 : -1);
     seekStop = true;
+    timerWakeFromISR();
   }
 }
 
+#if !defined(DISABLE_REMOTE) && ARDUINO_USB_MODE && ARDUINO_USB_CDC_ON_BOOT
+//
+// Wake up the main loop when serial input arrives
+//
+static void serialWake(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+  timerWake();
+}
+#endif
+
 //
 // Switch radio to given band
 //
 void useBand(const Band *band)
 {
+  // Apply pending commands before reconfiguring the radio
+  radioSync();
+
   // Set current frequency and mode, reset BFO
   currentFrequency = band->currentFreq;
   currentMode = band->bandMode;
@@ -409,7 +432,8 @@ bool updateBFO(int newBFO, bool wrap)
   // If need to change frequency...
   if(newFreq != currentFrequency)
   {
-    // Apply new frequency
+    // Apply new frequency, after any pending tuning
+    radioSync();
     rx.setFrequency(newFreq);
 
     // Re-apply to remove noise
@@ -422,7 +446,7 @@ bool updateBFO(int newBFO, bool wrap)
   currentBFO = newBFO;
 
   // To move frequency forward, need to move the BFO backwards
-  rx.setSSBBfo(-(currentBFO + band->bandCal));
+  radioSetBFO(-(currentBFO + band->bandCal));
 
   // Save current band frequency, w.r.t. new BFO value
   band->currentFreq = currentFrequency + currentBFO / 1000;
@@ -446,14 +470,14 @@ bool updateFrequency(int newFreq, bool wrap)
     if(!wrap) return false; else newFreq = band->minimumFreq;
   }
 
-  // Set new frequency
-  rx.setFrequency(newFreq);
+  // Set new frequency, without waiting for the radio
+  radioTune(newFreq);
 
   // Clear BFO, if present
   if(currentBFO) updateBFO(0, true);
 
   // Update current frequency
-  currentFrequency = rx.getFrequency();
+  currentFrequency = newFreq;
 
   // Save current band frequency
   band->currentFreq = currentFrequency + currentBFO / 1000;
@@ -486,6 +510,7 @@ bool doSeek(int8_t dir)
 
       // G8PTN: Flag is set by rotary encoder and cleared on seek entry
       seekStop = false;
+      radioSync();
       rx.seekStationProgress(showFrequencySeek, checkStopSeeking, dir>0? 1 : 0);
       updateFrequency(rx.getFrequency(), true);
     }
@@ -503,6 +528,12 @@ bool doSeek(int8_t dir)
 
     if(schedule) updateFrequency(schedule->freq, false);
   }
+  else if(seekMode() == SEEK_STATIONS)
+  {
+    // Step through stations found by the last scan, strongest first
+    uint16_t freq = scanStepStation(currentFrequency, dir);
+    if(freq) updateFrequency(freq, false);
+  }
 
   // Clear current station name and information
   clearStationInfo();
@@ -513,10 +544,15 @@ bool doSeek(int8_t dir)
 }
 
 //
-// Handle tuning
+// Handle tuning by given number of steps, with the first step
+// aligning frequency to the step grid
 //
-bool doTune(int8_t dir)
+bool doTune(int steps)
 {
+  int dir = steps>0? 1 : -1;
+
+  if(!steps) return(false);
+
   //
   // SSB tuning
   //
@@ -530,9 +566,9 @@ bool doTune(int8_t dir)
 
     uint32_t step = getCurrentStep()->step;
     uint32_t stepAdjust = (currentFrequency * 1000 + currentBFO) % step;
-    step = !stepAdjust? step : dir>0? step - stepAdjust : stepAdjust;
+    uint32_t first = !stepAdjust? step : dir>0? step - stepAdjust : stepAdjust;
 
-    updateBFO(currentBFO + dir * step, true);
+    updateBFO(currentBFO + dir * (int)first + (steps - dir) * (int)step, true);
   }
 
   //
@@ -549,10 +585,10 @@ bool doTune(int8_t dir)
     uint16_t step = getCurrentStep()->step;
     uint16_t stepAdjust = currentFrequency % step;
     stepAdjust = (currentMode==FM) && (step==20)? (stepAdjust+10) % step : stepAdjust;
-    step = !stepAdjust? step : dir>0? step - stepAdjust : stepAdjust;
+    uint16_t first = !stepAdjust? step : dir>0? step - stepAdjust : stepAdjust;
 
     // Tune to a new frequency
-    updateFrequency(currentFrequency + step * dir, true);
+    updateFrequency(currentFrequency + first * dir + (steps - dir) * step, true);
   }
 
   // Clear current station name and information
@@ -566,7 +602,7 @@ bool doTune(int8_t dir)
 //
 // Rotate digit
 //
-bool doDigit(int8_t dir)
+bool doDigit(int dir)
 {
   bool updated = false;
 
@@ -638,9 +674,13 @@ bool processRssiSnr()
   static uint32_t updateCounter = 0;
   bool needRedraw = false;
 
-  rx.getCurrentReceivedSignalQuality();
-  int newRSSI = rx.getCurrentRSSI();
-  int newSNR = rx.getCurrentSNR();
+  // Signal quality is sampled by the radio task, ignore samples
+  // taken before tuning to the current frequency
+  RadioSample sample;
+  if(!radioGetSample(&sample) || (sample.freq != currentFrequency)) return(false);
+
+  int newRSSI = sample.rssi;
+  int newSNR = sample.snr;
 
   // Apply squelch if the volume is not muted
   if(currentSquelch && currentSquelch <= 127)
@@ -681,6 +721,99 @@ bool processRssiSnr()
   return needRedraw;
 }
 
+//
+// Main loop timers, each returning TRUE if the screen needs a redraw
+//
+static bool tickRssiSnr()
+{
+  // Do not show signal levels of the frequencies being scanned
+  return(!scanIsRunning() && processRssiSnr());
+}
+
+static bool tickRds()
+{
+  // Check received RDS information, unless it comes from stations
+  // being scanned
+  return((currentMode == FM) && !scanIsRunning() && (snr >= 12) && checkRds());
+}
+
+static bool tickSchedule()
+{
+  return(identifyFrequency(currentFrequency + currentBFO / 1000, true));
+}
+
+static bool tickTimeouts()
+{
+  uint32_t currentTime = millis();
+  bool needRedraw = false;
+
+  // Disable commands control
+  if((currentTime - elapsedCommand) > ELAPSED_COMMAND)
+  {
+    if(currentCmd != CMD_NONE && currentCmd != CMD_SEEK)
+    {
+      currentCmd = CMD_NONE;
+      needRedraw = true;
+    }
+
+    elapsedCommand = currentTime;
+  }
+
+  // Display sleep timeout
+  if(currentSleep && !sleepOn() && ((currentTime - elapsedSleep) > currentSleep * 1000))
+  {
+    sleepOn(true);
+    // CPU sleep can take long time, renew the timestamps
+    elapsedSleep = elapsedCommand = millis();
+  }
+
+  return(needRedraw);
+}
+
+static bool tickBackground()
+{
+  // Tick EEPROM time, saving changes if the occurred and there has
+  // been no activity for a while
+  eepromTickTime();
+
+  // Tick NETWORK time, connecting to WiFi if requested
+  netTickTime();
+
+  // Tick EIBI time, installing schedule loaded in the background
+  bool needRedraw = eibiTickTime();
+
+  // Refresh stale scan data while the user is idle and the audio is
+  // silent anyway
+  bool scanIdle = (currentCmd == CMD_NONE) && (muteOn() || squelchCutoff) &&
+                  ((millis() - elapsedSleep) > SCAN_IDLE_TIME);
+  if(!scanIsRunning()) needRedraw |= scanTickTime(scanIdle);
+
+  return(needRedraw);
+}
+
+static bool tickRefresh()
+{
+  // Periodically refresh the main screen. This covers the case where
+  // there is nothing else triggering a refresh.
+  return(currentCmd == CMD_NONE);
+}
+
+static void initTimers()
+{
+  timerAdd(MIN_ELAPSED_RSSI_TIME, tickRssiSnr);
+  timerAdd(RDS_CHECK_TIME, tickRds);
+  timerAdd(SCHEDULE_CHECK_TIME, tickSchedule);
+  timerAdd(NTP_CHECK_TIME, ntpSyncTime);
+  timerAdd(TIMEOUT_CHECK_TIME, tickTimeouts);
+  timerAdd(TICK_TIME, tickBackground);
+  timerAdd(CLOCK_TICK_TIME, clockTickTime);
+#ifndef DISABLE_REMOTE
+  // Periodically print status to serial
+  timerAdd(STATUS_PRINT_TIME, [] () { remoteTickTime(); return(false); });
+#endif
+  background_timer = timerAdd(BACKGROUND_REFRESH_TIME, tickRefresh);
+}
+
 //
 // Main event loop
 //
@@ -689,20 +822,28 @@ void loop()
   uint32_t currentTime = millis();
   bool needRedraw = false;
 
+  // Talk to the radio directly while handling input and timers
+  radioLock();
+
   ButtonTracker::State pb1st = pb1.update(digitalRead(ENCODER_PUSH_BUTTON) == LOW);
 
-#ifndef DISABLE_REMOTE
-  // Periodically print status to serial
-  remoteTickTime();
+  // Pop encoder detents since the last pass, with tuning steps
+  // accelerated for fast spins
+  int encoderSteps;
+  int encoderCount = encoderRead(&encoderSteps);
 
+#ifndef DISABLE_REMOTE
   // Receive and execute serial command
   if(Serial.available()>0)
   {
+    // Serial commands may retune, stop scanning first
+    scanStop();
+
     int revent = remoteDoCommand(Serial.read());
     needRedraw |= !!(revent & REMOTE_CHANGED);
     pb1st.wasClicked |= !!(revent & REMOTE_CLICK);
     int direction = revent >> REMOTE_DIRECTION;
-    encoderCount = direction? direction : encoderCount;
+    if(direction) encoderCount = encoderSteps = direction;
     if(revent & REMOTE_EEPROM) eepromRequestSave();
   }
 #endif
@@ -712,6 +853,19 @@ void loop()
   // Block encoder rotation when in the locked sleep mode
   if(encoderCount && sleepOn() && sleepModeIdx==SLEEP_LOCKED) encoderCount = 0;
 
+  // Other than tuning, act on one detent per pass as before
+  int encoderDir = encoderCount>0? 1 : encoderCount<0? -1 : 0;
+
+  // Encoder rotation or click cancels the scan, returning to the
+  // user frequency right away
+  if(scanIsRunning() && (encoderCount || pb1st.wasClicked || pb1st.wasShortPressed))
+  {
+    scanStop();
+    pb1st.wasClicked = pb1st.wasShortPressed = false;
+    encoderCount = 0;
+    needRedraw = true;
+  }
+
   // Activate push and rotate mode (can span multiple loop iterations until the button is released)
   if (encoderCount && pb1st.isPressed) pushAndRotate = true;
 
@@ -730,7 +884,7 @@ void loop()
           break;
         case CMD_FREQ:
           // Select digit
-          doSelectDigit(encoderCount);
+          doSelectDigit(encoderDir);
           needRedraw = true;
           break;
         case CMD_SEEK:
@@ -739,9 +893,6 @@ void loop()
           eepromRequestSave();
           break;
       }
-
-      // Clear encoder rotation
-      encoderCount = 0;
     }
     // Reset timeouts while push and rotate is active
     elapsedSleep = elapsedCommand = currentTime;
@@ -754,8 +905,8 @@ void loop()
       switch(currentCmd)
       {
         case CMD_NONE:
-          // Tuning
-          needRedraw |= doTune(encoderCount);
+          // Tuning, the whole burst at once
+          needRedraw |= doTune(encoderSteps);
           break;
         case CMD_FREQ:
           // Digit tuning
@@ -763,22 +914,22 @@ void loop()
           break;
         case CMD_SEEK:
           // Seek mode
-          needRedraw |= doSeek(encoderCount);
+          needRedraw |= doSeek(encoderDir);
+          // Detents turned during seek have stopped it, drop them
+          // rather than starting another seek
+          encoderRead();
           // Seek can take long time, renew the timestamp
           currentTime = millis();
           break;
         default:
           // Side bar menus / settings
-          needRedraw |= doSideBar(currentCmd, encoderCount);
+          needRedraw |= doSideBar(currentCmd, encoderDir);
           break;
       }
 
       // Reset timeouts
       elapsedSleep = elapsedCommand = currentTime;
       eepromRequestSave();
-
-      // Clear encoder rotation
-      encoderCount = 0;
     }
     else if(pb1st.isLongPressed)
     {
@@ -851,59 +1002,11 @@ void loop()
     needRedraw = true;
   }
 
-  // Disable commands control
-  if((currentTime - elapsedCommand) > ELAPSED_COMMAND)
-  {
-    if(currentCmd != CMD_NONE && currentCmd != CMD_SEEK)
-    {
-      currentCmd = CMD_NONE;
-      needRedraw = true;
-    }
+  // Run expired timers
+  needRedraw |= timerTickTime();
 
-    elapsedCommand = currentTime;
-  }
-
-  // Display sleep timeout
-  if(currentSleep && !sleepOn() && ((currentTime - elapsedSleep) > currentSleep * 1000))
-  {
-    sleepOn(true);
-    // CPU sleep can take long time, renew the timestamps
-    elapsedSleep = elapsedCommand = currentTime = millis();
-  }
-
-  if((currentTime - elapsedRSSI) > MIN_ELAPSED_RSSI_TIME)
-  {
-    needRedraw |= processRssiSnr();
-    elapsedRSSI = currentTime;
-  }
-
-  // Periodically check received RDS information
-  if((currentTime - lastRDSCheck) > RDS_CHECK_TIME)
-  {
-    needRedraw |= (currentMode == FM) && (snr >= 12) && checkRds();
-    lastRDSCheck = currentTime;
-  }
-
-  // Periodically check schedule
-  if((currentTime - lastScheduleCheck) > SCHEDULE_CHECK_TIME)
-  {
-    needRedraw |= identifyFrequency(currentFrequency + currentBFO / 1000, true);
-    lastScheduleCheck = currentTime;
-  }
-
-  // Periodically synchronize time via NTP
-  if((currentTime - lastNTPCheck) > NTP_CHECK_TIME)
-  {
-    needRedraw |= ntpSyncTime();
-    lastNTPCheck = currentTime;
-  }
-
-  // Tick EEPROM time, saving changes if the occurred and there has
-  // been no activity for a while
-  eepromTickTime();
-
-  // Tick NETWORK time, connecting to WiFi if requested
-  netTickTime();
+  // Tick SCAN time, measuring the next scan point as soon as possible
+  if(scanIsRunning()) needRedraw |= scanTickTime();
 
 #ifdef ENABLE_HOLDOFF
   // Check if tuning flag is set
@@ -914,21 +1017,23 @@ void loop()
   }
 #endif
 
-  // Run clock
-  needRedraw |= clockTickTime();
+  // Let the radio task run while drawing and sleeping
+  radioUnlock();
 
-  // Periodically refresh the main screen
-  // This covers the case where there is nothing else triggering a refresh
-  if(needRedraw) background_timer = currentTime;
-  if((currentTime - background_timer) > BACKGROUND_REFRESH_TIME)
+  // Redraw screen if necessary, postponing the background refresh
+  if(needRedraw)
   {
-    if(currentCmd == CMD_NONE) needRedraw = true;
-    background_timer = currentTime;
+    drawScreen();
+    timerRestart(background_timer);
   }
 
-  // Redraw screen if necessary
-  if(needRedraw) drawScreen();
-
-  // Add a small default delay in the main loop
-  delay(5);
+  // Sleep until the next timer expires or an input event occurs.
+  // Keep polling while the button is down (debouncing, long press),
+  // input is pending, or a scan is running.
+  bool polling = scanIsRunning() || pushAndRotate || pb1st.isPressed || encoderPending() ||
+                 (digitalRead(ENCODER_PUSH_BUTTON) == LOW) || (Serial.available() > 0);
+#ifdef ENABLE_HOLDOFF
+  polling |= tuning_flag;
+#endif
+  timerSleep(polling? MIN_ELAPSED_TIME : MAX_SLEEP_TIME);
 }